@@ -0,0 +1,28 @@
+#ifndef INCLUDE_UNSTICKYMEM_BANDWIDTHPROBE_HPP_
+#define INCLUDE_UNSTICKYMEM_BANDWIDTHPROBE_HPP_
+
+#include <stdlib.h>
+
+#include <vector>
+
+namespace unstickymem {
+
+// buffer each probing thread reads, well past its share of the caches
+static const size_t DEFAULT_PROBE_BUFFER_SIZE = 32UL << 20;
+// how long each node is probed
+static const double DEFAULT_PROBE_SECONDS = 0.2;
+
+// read bandwidth (bytes/s) that threads on every cpu of the worker nodes
+// get together from the memory of each node, indexed by node id. nodes
+// without memory get 0. like bench-private, every thread streams through
+// a private buffer bound to the probed node
+std::vector<double> measure_node_bandwidth(
+    size_t buffer_size = DEFAULT_PROBE_BUFFER_SIZE,
+    double seconds = DEFAULT_PROBE_SECONDS);
+
+// weights (in percent) proportional to the bandwidth of each node
+std::vector<double> bandwidth_weights(const std::vector<double> &bandwidth);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_BANDWIDTHPROBE_HPP_
@@ -5,6 +5,10 @@
 #include <numaif.h>
 #include <numa.h>
 
+#include <functional>
+#include <string>
+#include <vector>
+
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/memory/MemorySegment.hpp"
 
@@ -22,11 +26,40 @@ static const int PAGE_MASK = (~(PAGE_SIZE - 1));
 #define MPOL_LOCAL 4
 #endif
 
+// fallback when the kernel does not export the transparent huge page size
+static const size_t DEFAULT_HUGE_PAGE_SIZE = 2UL << 20;
+
+// THP-aware placement: large segments are advised to use transparent huge
+// pages, and are placed and migrated in whole huge pages so that neither
+// the interleaving nor the migrations split them
+void huge_page_placement(bool enabled);
+bool huge_page_placement();
+size_t huge_page_size();
+// pages per stripe of the placers, so that neighbouring pages share a node
+// and the prefetchers stay on it: 1 interleaves page by page
+void placement_granularity(size_t pages);
+size_t placement_granularity();
+// pages per stripe given as page, huge, a number of pages or a size with a
+// K, M or G suffix (e.g. 64K); 0 if invalid
+size_t parse_granularity(const std::string &spec);
+// base pages that always go to the same node: a stripe, rounded up to
+// whole huge pages with THP-aware placement
+size_t placement_unit_pages();
+// asks for transparent huge pages on a segment large enough to hold one
+void advise_huge_pages(const MemorySegment &segment);
+
 void force_uniform_interleave(char *addr, unsigned long len);
 void force_uniform_interleave(MemorySegment &segment);
 void place_pages(void *addr, unsigned long len, double ratio);
 void place_pages_weighted_initial(const MemorySegment &segment);
 void place_pages_weighted_initial(void *addr, unsigned long len);
+// nodes with a non-zero weight, a mask returned stays valid when the
+// weights change
+struct bitmask *weighted_nodes_nodemask(void);
+// runs place on a copy of each segment of more than min_length bytes,
+// without the segment lock, and stores the copy's placement back
+void place_segments(MemoryMap &segments, size_t min_length,
+                    const std::function<void(MemorySegment&)> &place);
 void place_all_pages(MemoryMap &segments, double ratio);
 void place_all_pages(double ratio);
 
@@ -35,8 +68,21 @@ void place_pages_weighted_contiguous(void *addr, unsigned long len);
 
 void place_pages_weighted_dwp(void *addr, unsigned long len, double s);
 void move_pages_remote(void *addr, unsigned long len, double ratio);
+void move_pages_remote(MemorySegment &segment, double ratio);
 void move_pages_initial(void *start, unsigned long len);
 
+// weights are indexed by node id and need not sum up to 100
+void move_pages_weighted(MemorySegment &segment,
+                         const std::vector<double> &weights);
+void place_all_pages_weighted(MemoryMap &segments,
+                              const std::vector<double> &weights);
+// the weights read from BWAP_WEIGHTS, indexed by node id
+std::vector<double> node_weights(void);
+// replaces the weights the placers use, indexed by node id
+void set_node_weights(const std::vector<double> &weights);
+// rebuilds what the placers derive from the weights, after they changed
+void node_weights_changed(void);
+
 void place_pages_weighted_s(void *addr, unsigned long len, double s);
 void place_pages_weighted(void *addr, unsigned long len);
 void place_all_pages_adaptive(double ratio);
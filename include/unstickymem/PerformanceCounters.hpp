@@ -4,25 +4,55 @@
 #include <cstdint>
 
 #include <string>
+#include <vector>
+
+#include "better-enums/enum.h"
+#include "unstickymem/counters/StallRateSampler.hpp"
 
 namespace unstickymem {
 
-void initialize_likwid();
+// what the modes minimize: the stall rate from the counters, or minus the
+// throughput the application reports with unstickymem_report_progress
+BETTER_ENUM(Objective, int, STALLS, PROGRESS)
+
+// with the progress objective, the stall rate functions below return minus
+// the reported operations per second and the counters are never started
+void set_objective(Objective objective);
+Objective get_objective(void);
+
+// starts the configured counter backend (see counters/CounterBackend.hpp)
+void initialize_counters();
 
 // checks performance counters and computes stalls per second since last call
 double get_stall_rate();  // via joao barreto's lib
 
-double get_stall_rate_v2();  // via Like I Knew What I'm Doing (LIKWID Library!)
+// average over the monitored cpus, via the configured counter backend.
+// also stores the rate of each node in node_rates, if given
+double get_stall_rate_v2(std::vector<double> *node_rates = nullptr);
+// stall rate of each node during the last get_stall_rate_v2 interval,
+// NaN for nodes without monitored cpus (and in process or thread scope)
+std::vector<double> get_node_stall_rates();
+// bytes per second moved by each node's memory controllers since the last
+// call, NaN for nodes whose controllers are not counted
+std::vector<double> get_node_bandwidth();
 void stop_all_counters();  // Restarting it might have some issues if counters are not stopped!
 double get_elapsed_stall_rate();  //get the elapsed stall rate
 
-// samples stall rate multiple times and filters outliers
+// samples stall rate multiple times and filters outliers. with the stall
+// rate sampler enabled, num_measurements is an upper bound: sampling stops
+// once the sampler reaches its confidence target, at the sampler's period
 double get_average_stall_rate(size_t num_measurements,
                               useconds_t usec_between_measurements,
                               size_t num_outliers_to_filter);
 double get_average_stall_rate2(size_t num_measurements,
                                useconds_t usec_between_measurements,
                                size_t num_outliers_to_filter);
+// same measurement, with the spread of the samples for significance tests
+StallStats get_stall_stats(size_t num_measurements,
+                           useconds_t usec_between_measurements,
+                           size_t num_outliers_to_filter);
+// per-node stall rates averaged over the last get_average_stall_rate call
+std::vector<double> get_average_node_stall_rates();
 
 //output stall rate to a log file
 void unstickymem_log(double ratio, double sr);
@@ -0,0 +1,31 @@
+#ifndef INCLUDE_UNSTICKYMEM_PLACEMENTCACHE_HPP_
+#define INCLUDE_UNSTICKYMEM_PLACEMENTCACHE_HPP_
+
+#include <string>
+#include <vector>
+
+namespace unstickymem {
+
+// result of an earlier run, either field may be missing
+struct CachedPlacement {
+  double ratio = -1;            // local ratio, negative if unknown
+  std::vector<double> weights;  // per node id, empty if unknown
+};
+
+// key of what the machine looks like: cpu model, NUMA distance matrix
+// and worker nodes
+std::string topology_key(void);
+
+// topology_key plus a hash of the running executable
+std::string workload_key(void);
+
+// the cache lives in $UNSTICKYMEM_CACHE (default $XDG_CACHE_HOME/unstickymem
+// or ~/.cache/unstickymem), UNSTICKYMEM_CACHE=off disables it. both return
+// false if there is no cache
+bool load_cached_placement(const std::string &key, CachedPlacement *entry);
+bool store_cached_placement(const std::string &key,
+                            const CachedPlacement &entry);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_PLACEMENTCACHE_HPP_
@@ -0,0 +1,101 @@
+#ifndef INCLUDE_UNSTICKYMEM_PLACEMENTPLAN_HPP_
+#define INCLUDE_UNSTICKYMEM_PLACEMENTPLAN_HPP_
+
+#include <stdlib.h>
+
+#include <vector>
+
+namespace unstickymem {
+
+// slots in the pattern of a spread plan: the weights are honoured to
+// within one unit per period, and per the shorter pattern of the rest
+static const size_t SPREAD_PERIOD = 1024;
+
+// how the pages of a range map to placement units: units are aligned to
+// their own size, so the first and the last one may be partial
+struct UnitLayout {
+  size_t unit = 1;   // pages per unit
+  size_t lead = 0;   // pages of the first unit before the range
+  size_t pages = 0;  // pages of the range
+  size_t units = 0;  // units the range touches
+};
+
+UnitLayout unit_layout(void *start, size_t page_count, size_t unit_pages);
+
+// consecutive units that repeat a pattern of nodes, one unit per slot. a
+// stripe with a single slot is a plain run
+struct PlanStripe {
+  size_t first;  // first unit
+  size_t units;
+  std::vector<int> pattern;
+};
+
+// units each node gets when units are split by weights (indexed by node
+// id): every node is within one unit of its exact share, the remainders
+// go to the largest fractional parts
+std::vector<size_t> apportion_units(size_t units,
+                                    const std::vector<double> &weights);
+
+// where the pages of a range go, run-length encoded as a few periodic
+// stripes: its size and the time to build it depend on the number of
+// stripes and the length of their patterns, not on the number of pages
+class PlacementPlan {
+ private:
+  UnitLayout _layout;
+  std::vector<PlanStripe> _stripes;
+
+ private:
+  void add(size_t units, std::vector<int> pattern);
+  size_t stripeOf(size_t unit) const;
+
+ public:
+  // interleaves the units while every node has some left: the nodes with
+  // the smallest share drop out first, so there are at most as many
+  // stripes as nodes, each dealing to its nodes in ascending order
+  static PlacementPlan interleaved(const UnitLayout &layout,
+                                   const std::vector<double> &weights);
+  // one run per node, in node id order
+  static PlacementPlan contiguous(const UnitLayout &layout,
+                                  const std::vector<double> &weights);
+  // a stripe whose pattern gives each node its share of slots, in
+  // the order of the fractional parts of multiples of the golden ratio:
+  // every node's units are spread evenly, and a small change of the
+  // weights only moves the units near the shifted boundaries
+  static PlacementPlan spread(const UnitLayout &layout,
+                              const std::vector<double> &weights);
+  // the first units alternate between a local and a remote node, the rest
+  // go round-robin to the local nodes (ratio <= 50) or to the remote ones
+  static PlacementPlan remoteRatio(const UnitLayout &layout,
+                                   double remote_ratio,
+                                   const std::vector<int> &local_nodes,
+                                   const std::vector<int> &remote_nodes);
+
+  const UnitLayout& layout() const;
+  const std::vector<PlanStripe>& stripes() const;
+  // node of a unit or of a page of the range
+  int nodeOf(size_t unit) const;
+  int nodeOfPage(size_t page) const;
+  // units each node gets, indexed by node id
+  std::vector<size_t> nodeUnits() const;
+};
+
+// walks the pages of a plan in order, a step costs no lookup
+class PlanCursor {
+ private:
+  const PlacementPlan &_plan;
+  size_t _page;
+  size_t _unit;
+  size_t _stripe;
+  size_t _slot;
+
+ public:
+  PlanCursor(const PlacementPlan &plan, size_t page);
+
+  bool done() const;
+  int node() const;
+  void next();
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_PLACEMENTPLAN_HPP_
@@ -0,0 +1,18 @@
+#ifndef INCLUDE_UNSTICKYMEM_PROGRESS_HPP_
+#define INCLUDE_UNSTICKYMEM_PROGRESS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace unstickymem {
+
+// threads beyond this many share their progress counters
+static const size_t PROGRESS_SLOTS = 256;
+
+// operations reported by all the threads so far, see
+// unstickymem_report_progress
+uint64_t progress_total(void);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_PROGRESS_HPP_
@@ -0,0 +1,39 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_CHANGEDETECTOR_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_CHANGEDETECTOR_HPP_
+
+#include <cstddef>
+
+namespace unstickymem {
+
+// two-sided Page-Hinkley test: signals once the observations drifted away
+// from their running mean, in either direction, by more than threshold in
+// total, ignoring drifts smaller than delta per observation
+class ChangeDetector {
+ private:
+  double _delta;
+  double _threshold;
+
+  size_t _count = 0;
+  double _mean = 0;
+  // cumulative deviations and their extremes, for increases and decreases
+  double _up = 0;
+  double _up_min = 0;
+  double _down = 0;
+  double _down_max = 0;
+
+ public:
+  ChangeDetector(double delta, double threshold);
+
+  // forgets the observations, e.g. after the placement changed
+  void reset();
+
+  // adds an observation, true if the mean changed
+  bool add(double value);
+
+  // how far the larger of both sums is from its extreme
+  double statistic() const;
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_CHANGEDETECTOR_HPP_
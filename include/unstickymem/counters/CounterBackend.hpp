@@ -0,0 +1,119 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_COUNTERBACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_COUNTERBACKEND_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "better-enums/enum.h"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+// what the counters are attached to: each monitored cpu, every thread of
+// the process or only the thread that starts them
+BETTER_ENUM(CounterScope, int, CPU, PROCESS, THREAD)
+
+struct CounterConfig {
+  CounterScope scope = CounterScope::PROCESS;
+  std::vector<int> cpus;   // cpus to monitor in cpu scope, empty for all
+                           // the cpus in the affinity mask
+  uint64_t raw_event = 0;  // raw stall event, 0 picks one for the cpu
+  bool memory_traffic = true;  // also count the memory controller traffic
+};
+
+// stall cycles counted on one monitored unit since the counters started
+struct CounterValue {
+  int cpu;  // -1 if the unit is not a cpu
+  double stalls;
+};
+
+// bytes moved by the memory controllers of one node since the counters
+// started
+struct NodeTraffic {
+  int node;
+  double read_bytes;
+  double write_bytes;
+};
+
+// source of the stall counts behind the stall rate
+class CounterBackend {
+  using create_f = std::unique_ptr<CounterBackend>();
+  using Description = struct {
+    create_f* create_function;
+    std::string description;
+  };
+
+ private:
+  static std::map<std::string, Description> & registry();
+
+ public:
+  virtual ~CounterBackend() = default;
+
+  // sets up and starts the counters, false if they are not available
+  virtual bool start(const CounterConfig &config) = 0;
+  // appends the current count of every monitored unit, false on error
+  virtual bool read(std::vector<CounterValue> *values) = 0;
+  virtual void stop() = 0;
+
+  // appends the traffic of every node whose memory controllers are counted,
+  // false if the backend does not count them
+  virtual bool readTraffic(std::vector<NodeTraffic> *traffic) {
+    return false;
+  }
+
+  static void registerBackend(std::string const & name, Description desc) {
+    // disallow replacing entries
+    DIEIF(registry().count(name) == 1, "Counter backend already registered");
+    registry()[name] = desc;
+  }
+
+  // nullptr if there is no backend with that name
+  static std::unique_ptr<CounterBackend> getBackend(std::string const & name) {
+    if (registry().count(name) == 0) {
+      return nullptr;
+    }
+    return registry()[name].create_function();
+  }
+
+  static std::vector<std::string> availableBackends() {
+    std::vector<std::string> names;
+    for (auto & [name, d] : registry()) {
+      names.push_back(name);
+    }
+    return names;
+  }
+
+  static void printAvailableBackends() {
+    LWARN("Available Counter Backends:");
+    for (auto & [name, d] : registry()) {
+      LWARNF("> %-10s (%s)", name.c_str(), d.description.c_str());
+    }
+  }
+
+  template<typename BackendImplementation>
+  struct Registrar {
+    explicit Registrar(std::string const & name,
+                       std::string const & description) {
+      CounterBackend::registerBackend(
+          name, { &BackendImplementation::createInstance, description });
+    }
+  };
+};
+
+// cpus of a list like "0-3,8", empty if it cannot be parsed
+std::vector<int> parse_cpu_list(std::string const & list);
+
+// selects the backend used by the stall rate functions
+void configure_counters(std::string const & backend, CounterConfig config);
+
+// the configured backend, started on first use. falls back to the other
+// backends when it cannot count and dies if none can
+CounterBackend& counters(void);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_COUNTERBACKEND_HPP_
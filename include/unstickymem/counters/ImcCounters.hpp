@@ -0,0 +1,40 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_IMCCOUNTERS_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_IMCCOUNTERS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "unstickymem/counters/CounterBackend.hpp"
+
+namespace unstickymem {
+
+// CAS counts of the memory controllers through the uncore PMUs the kernel
+// exports (uncore_imc_*), independent of how the stalls are counted
+class ImcCounters {
+ private:
+  struct Counter {
+    int node;
+    int fd;
+    double bytes;  // bytes per count
+    bool write;
+  };
+
+  std::vector<Counter> _counters;
+
+ private:
+  bool openEvent(const std::string &pmu, const std::string &event, bool write);
+
+ public:
+  ~ImcCounters();
+
+  // opens the read and write CAS counters of every controller, false if
+  // there are none we may count
+  bool start();
+  // bytes moved by each node's controllers since start, false on error
+  bool read(std::vector<NodeTraffic> *traffic);
+  void stop();
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_IMCCOUNTERS_HPP_
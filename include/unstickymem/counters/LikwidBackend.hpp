@@ -0,0 +1,40 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_LIKWIDBACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_LIKWIDBACKEND_HPP_
+
+#include <string>
+#include <vector>
+
+#include "unstickymem/counters/CounterBackend.hpp"
+#include "unstickymem/counters/ImcCounters.hpp"
+
+namespace unstickymem {
+
+// counts stalls on the monitored cpus with LIKWID's perfmon module
+class LikwidBackend : public CounterBackend {
+ private:
+  std::vector<int> _cpus;
+  int _gid = -1;
+  ImcCounters _imc;
+
+ public:
+  static std::string name() {
+    return "likwid";
+  }
+
+  static std::string description() {
+    return "LIKWID perfmon (needs MSR access)";
+  }
+
+  static std::unique_ptr<CounterBackend> createInstance() {
+    return std::make_unique<LikwidBackend>();
+  }
+
+  bool start(const CounterConfig &config);
+  bool read(std::vector<CounterValue> *values);
+  void stop();
+  bool readTraffic(std::vector<NodeTraffic> *traffic);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_LIKWIDBACKEND_HPP_
@@ -0,0 +1,57 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_PERFBACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_PERFBACKEND_HPP_
+
+#include <sys/types.h>
+#include <linux/perf_event.h>
+
+#include <string>
+#include <vector>
+
+#include "unstickymem/counters/CounterBackend.hpp"
+#include "unstickymem/counters/ImcCounters.hpp"
+
+namespace unstickymem {
+
+// counts stalls with perf_event_open, no MSR access needed
+class PerfBackend : public CounterBackend {
+ private:
+  // stalls (leader) and unhalted cycles, scheduled together
+  struct Group {
+    int cpu;
+    int stalls_fd = -1;
+    int cycles_fd = -1;
+    struct perf_event_mmap_page *page = nullptr;  // thread scope only
+  };
+
+  std::vector<Group> _groups;
+  struct perf_event_attr _stalls_attr;
+  pid_t _owner = -1;  // thread that counts itself in thread scope
+  ImcCounters _imc;
+
+ private:
+  bool selectStallEvent(uint64_t raw_event);
+  bool openGroup(pid_t pid, int cpu, bool inherit, Group *group);
+
+ public:
+  static std::string name() {
+    return "perf";
+  }
+
+  static std::string description() {
+    return "Linux perf_event_open";
+  }
+
+  static std::unique_ptr<CounterBackend> createInstance() {
+    return std::make_unique<PerfBackend>();
+  }
+
+  ~PerfBackend();
+  bool start(const CounterConfig &config);
+  bool read(std::vector<CounterValue> *values);
+  void stop();
+  bool readTraffic(std::vector<NodeTraffic> *traffic);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_PERFBACKEND_HPP_
@@ -0,0 +1,48 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_SIMULATEDBACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_SIMULATEDBACKEND_HPP_
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "unstickymem/counters/CounterBackend.hpp"
+#include "unstickymem/numa/SimulatedNuma.hpp"
+
+namespace unstickymem {
+
+// stalls and memory traffic of the simulated machine, only available with
+// UNSTICKYMEM_NUMA=sim
+class SimulatedBackend : public CounterBackend {
+ private:
+  SimulatedNuma *_numa = nullptr;
+  double _stalls = 0;
+  std::vector<double> _bytes;
+  uint64_t _clock = 0;
+  struct timespec _time;
+
+  // accumulates the counts since the last call
+  void advance();
+
+ public:
+  static std::string name() {
+    return "sim";
+  }
+
+  static std::string description() {
+    return "Stalls derived from the simulated page placement";
+  }
+
+  static std::unique_ptr<CounterBackend> createInstance() {
+    return std::make_unique<SimulatedBackend>();
+  }
+
+  bool start(const CounterConfig &config);
+  bool read(std::vector<CounterValue> *values);
+  bool readTraffic(std::vector<NodeTraffic> *traffic);
+  void stop();
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_SIMULATEDBACKEND_HPP_
@@ -0,0 +1,141 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_STALLRATESAMPLER_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_STALLRATESAMPLER_HPP_
+
+#include <unistd.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace unstickymem {
+
+// default time between two stall rate samples
+static const useconds_t DEFAULT_SAMPLER_PERIOD = 50000;
+// default relative half-width of the 95% confidence interval to reach
+static const double DEFAULT_SAMPLER_CONFIDENCE = 0.02;
+// default weight of the newest sample in the moving average
+static const double DEFAULT_SAMPLER_EWMA_ALPHA = 0.2;
+// fewest samples a measurement is based on
+static const size_t MIN_SAMPLER_SAMPLES = 5;
+
+// one stall rate reading
+struct StallSample {
+  double time;  // seconds since the sampler started
+  double rate;
+};
+
+// estimators over the samples of the current window
+struct StallStats {
+  size_t count = 0;
+  double last = 0;
+  double ewma = 0;
+  double mean = 0;
+  double variance = 0;  // sample variance
+  double median = 0;
+  double trimmed_mean = 0;
+
+  // half-width of the 95% confidence interval of the mean
+  double confidence() const;
+};
+
+// estimators over a batch of samples, in the order they were taken
+StallStats summarize_stall_rates(const std::vector<double> &rates,
+                                 double trim, double alpha);
+
+// outcome of comparing the mean stall rates of two windows
+enum class StallComparison {
+  LOWER,
+  HIGHER,
+  UNDECIDED
+};
+
+// Welch's t-test of the mean of a against the mean of b, two-sided at the
+// given significance level
+StallComparison compare_stall_rates(const StallStats &a, const StallStats &b,
+                                    double significance);
+
+// background thread that keeps sampling the stall rate, so that modes can
+// query robust estimates at any time instead of sleeping through a batch
+// of measurements
+class StallRateSampler {
+ private:
+  static constexpr size_t CAPACITY = 1024;
+
+  bool _enabled = true;
+  useconds_t _period = DEFAULT_SAMPLER_PERIOD;
+  double _confidence = DEFAULT_SAMPLER_CONFIDENCE;
+  double _alpha = DEFAULT_SAMPLER_EWMA_ALPHA;
+
+  std::once_flag _started;
+  std::mutex _lock;
+  std::condition_variable _sampled;
+
+  // ring buffer with the latest samples, across windows
+  StallSample _ring[CAPACITY];
+  size_t _total = 0;
+  // first sample of the current window
+  size_t _window_start = 0;
+  bool _discard_next = false;
+
+  // streaming estimators of the current window
+  double _ewma = 0;
+  double _mean = 0;
+  double _m2 = 0;
+  std::vector<double> _node_sums;
+  std::vector<size_t> _node_counts;
+
+ private:
+  StallRateSampler() = default;
+  void start();
+  void samplerThread();
+  void addSample(double time, double rate,
+                 const std::vector<double> &node_rates);
+  size_t windowSize() const;
+  StallStats computeStats(double trim) const;
+
+ public:
+  // singleton
+  static StallRateSampler& getInstance(void);
+  StallRateSampler(StallRateSampler const&) = delete;
+  void operator=(StallRateSampler const&) = delete;
+
+  void configure(bool enabled, useconds_t period, double confidence,
+                 double alpha);
+  bool enabled() const;
+
+  // starts a new window, e.g. after the placement changed
+  void reset();
+
+  // estimates over the current window, trimming that fraction of the
+  // samples from each end for the trimmed mean
+  StallStats stats(double trim);
+
+  // starts a new window and waits until its mean is within the confidence
+  // target, with at least min_samples and at most max_samples samples
+  StallStats measure(size_t min_samples, size_t max_samples, double trim);
+
+  // waits until the current window has at least count samples
+  StallStats extend(size_t count, double trim);
+
+  // Welch's test of the current window against other, extending the window
+  // while undecided until it holds max_samples. without the sampler the
+  // test runs once
+  StallComparison compare(StallStats *current, const StallStats &other,
+                          double significance, size_t max_samples,
+                          double trim);
+  // the same with the trim of the polling parameters of the modes:
+  // num_outliers of every num_polls samples from each end
+  StallComparison compare(StallStats *current, const StallStats &other,
+                          double significance, size_t max_samples,
+                          unsigned int num_polls, unsigned int num_outliers);
+
+  // mean rate of each node over the current window, NaN if unknown
+  std::vector<double> nodeRates();
+
+  // the latest samples, oldest first
+  std::vector<StallSample> history(size_t count);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_STALLRATESAMPLER_HPP_
@@ -3,10 +3,13 @@
 
 #include <stdlib.h>
 
+#include <atomic>
 #include <list>
+#include <map>
 #include <iterator>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/interprocess/containers/list.hpp>
@@ -15,6 +18,7 @@
 #include <boost/interprocess/allocators/allocator.hpp>
 
 #include "unstickymem/memory/MemorySegment.hpp"
+#include "unstickymem/memory/SegmentEventQueue.hpp"
 
 namespace unstickymem {
 
@@ -28,16 +32,26 @@ using Alloc = ipc::allocator<T, Manager>;
 template<typename K>
 using List = ipc::list<K, Alloc<K> >;
 
-typedef std::list<MemorySegment> SegmentsList;
+// allocations below this size are not tracked (glibc's default mmap threshold)
+static const size_t DEFAULT_TRACKING_THRESHOLD = 128 << 10;
+
+// segments indexed by start address, they never overlap
+typedef std::map<uintptr_t, MemorySegment> SegmentsTree;
 
 class MemoryMap {
  private:
-  SegmentsList *_segments;
+  SegmentsTree *_segments;
   MemorySegment *_heap = nullptr;
   MemorySegment *_stack = nullptr;
   MemorySegment *_text = nullptr;
   MemorySegment *_data = nullptr;
-  std::mutex _segments_lock;
+  // program break at the last heap refresh, inHeap decides with it and
+  // only reads the break again for addresses past it
+  std::atomic<uintptr_t> _heap_end { 0 };
+  // the segments are only reached under it, from outside through
+  // largestSegments, copySegment and updateSegment
+  mutable std::mutex _segments_lock;
+  static size_t _tracking_threshold;
 
   // FIXME(joaomlneto): this won't work if multiple unstickymem processes
   //                    are running!!!
@@ -46,6 +60,17 @@ class MemoryMap {
  private:
   MemoryMap();
 
+  // segment index, callers must hold _segments_lock
+  SegmentsTree::iterator findSegment(void *addr);
+  MemorySegment& addSegment(void *start, void *end, std::string name);
+  void removeSegment(SegmentsTree::iterator it);
+  void removeSegment(void *addr);
+
+  // indexes a new segment and then, without the lock, queues or runs its
+  // placement
+  void trackSegment(void *start, void *end, std::string name);
+  void segmentAdded(const MemorySegment &segment);
+
  public:
   // singleton
   static MemoryMap& getInstance(void);
@@ -55,12 +80,30 @@ class MemoryMap {
   void *getHeapStartAddress(void) const;
   void print(void) const;
   void updateHeap(void);
-
-  // iterators
-  SegmentsList::iterator begin() noexcept;
-  SegmentsList::iterator end() noexcept;
-  SegmentsList::const_iterator cbegin() const noexcept;
-  SegmentsList::const_iterator cend() const noexcept;
+  bool inHeap(void *addr);
+
+  // runs the mode's placement for a queued segment addition
+  void processSegmentEvent(const SegmentEvent &event);
+
+  // start addresses of the count largest segments of more than min_length
+  // bytes, largest first
+  std::vector<void*> largestSegments(size_t count, size_t min_length);
+  // copies the segment that starts at start, false if it has been freed.
+  // pages are moved on the copy without holding the segment lock, which
+  // the threads the migration starts need for their stacks
+  bool copySegment(void *start, MemorySegment *segment);
+  // stores the placement and tuning of a copy back, false if the segment
+  // has been freed or resized since (the heap, which follows the break,
+  // only has to start at the same address). the segments that took its
+  // place are then placed again, as if they had just been added
+  bool updateSegment(const MemorySegment &segment);
+
+  // allocations smaller than the threshold bypass the memory map
+  static void trackingThreshold(size_t size);
+  static size_t trackingThreshold(void);
+  static bool isTracked(size_t size) {
+    return size >= _tracking_threshold;
+  }
 
   // handle allocations/deallocations
   void* handle_malloc(size_t size);
@@ -7,11 +7,33 @@
 
 namespace unstickymem {
 
+// page->node assignment last applied to a segment
+struct SegmentPlacement {
+  void *start = nullptr;
+  size_t pages = 0;
+  double remote_ratio = -1;  // negative when unknown or placed by weights
+  std::vector<double> weights;  // per node id, empty unless placed by weights
+
+  bool known() const {
+    return remote_ratio >= 0 || !weights.empty();
+  }
+};
+
+// where the segment tuning mode left a segment: its weights mix the local
+// and the bandwidth weights, the current ones are in its placement
+struct SegmentTuning {
+  double mix = -1;     // share of the bandwidth weights, negative until tuned
+  double step = 0;     // mix change of its next probes
+  double benefit = 0;  // relative drop of the objective at its last move
+};
+
 class MemorySegment {
  protected:
   void* _startAddress;
   void* _endAddress;
   std::string _name;
+  SegmentPlacement _placement;
+  SegmentTuning _tuning;
 
  public:
   MemorySegment(void *start, void *end, std::string name);
@@ -21,6 +43,8 @@ class MemorySegment {
   void* startAddress() const;
   void* endAddress() const;
   std::string name() const;
+  const SegmentPlacement& placement() const;
+  const SegmentTuning& tuning() const;
 
   // get derived attributes
   void* pageAlignedStartAddress() const;
@@ -32,6 +56,8 @@ class MemorySegment {
   void startAddress(void *addr);
   void endAddress(void *addr);
   void name(std::string name);
+  void placement(const SegmentPlacement &placement);
+  void tuning(const SegmentTuning &tuning);
 
   // utility functions
   void print() const;
@@ -0,0 +1,63 @@
+#ifndef INCLUDE_UNSTICKYMEM_MEMORY_SEGMENTEVENTQUEUE_HPP_
+#define INCLUDE_UNSTICKYMEM_MEMORY_SEGMENTEVENTQUEUE_HPP_
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace unstickymem {
+
+// a segment that was added to the memory map
+struct SegmentEvent {
+  void *start;
+  void *end;
+};
+
+// hands segment additions from the allocating threads to a placement thread.
+// every thread owns a single-producer/single-consumer ring, so queueing an
+// event takes no lock
+class SegmentEventQueue {
+ public:
+  static const size_t RING_SIZE = 1024;
+
+ private:
+  struct Ring {
+    std::atomic<size_t> head { 0 };  // next event to drain
+    std::atomic<size_t> tail { 0 };  // next free slot
+    std::atomic<bool> retired { false };  // owner thread has exited
+    Ring *next = nullptr;
+    SegmentEvent events[RING_SIZE];
+  };
+
+  bool _async = true;
+  bool _first_touch = true;
+  std::atomic<Ring*> _rings { nullptr };
+  std::once_flag _started;
+  std::mutex _idle_lock;
+  std::condition_variable _idle;
+
+ private:
+  SegmentEventQueue() = default;
+  Ring* threadRing();
+  void applyFirstTouchPolicy(const SegmentEvent &event);
+  size_t drain();
+  void drainerThread();
+
+ public:
+  // singleton
+  static SegmentEventQueue& getInstance(void);
+  SegmentEventQueue(SegmentEventQueue const&) = delete;
+  void operator=(SegmentEventQueue const&) = delete;
+
+  void configure(bool async, bool first_touch);
+
+  // queues the event of the calling thread; returns false if it must be
+  // processed synchronously (async placement disabled or ring full)
+  bool push(const SegmentEvent &event);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MEMORY_SEGMENTEVENTQUEUE_HPP_
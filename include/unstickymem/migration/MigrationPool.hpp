@@ -0,0 +1,86 @@
+#ifndef INCLUDE_UNSTICKYMEM_MIGRATION_MIGRATIONPOOL_HPP_
+#define INCLUDE_UNSTICKYMEM_MIGRATION_MIGRATIONPOOL_HPP_
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "unstickymem/migration/PageMigration.hpp"
+#include "unstickymem/PlacementPlan.hpp"
+
+namespace unstickymem {
+
+// default number of migration workers pinned to each NUMA node
+static const unsigned int DEFAULT_MIGRATION_WORKERS_PER_NODE = 1;
+
+// runs fn(first_page, num_pages) over a range of pages
+using RangeFunction = std::function<MigrationStats(size_t, size_t)>;
+
+class MigrationPool {
+ private:
+  struct Job;
+
+  struct Range {
+    std::shared_ptr<Job> job;
+    size_t first_page;
+    size_t num_pages;
+  };
+
+  // each worker owns a deque: it pops from the back, thieves steal the front
+  struct Worker {
+    int node;
+    std::mutex lock;
+    std::deque<Range> ranges;
+  };
+
+  unsigned int _workers_per_node = DEFAULT_MIGRATION_WORKERS_PER_NODE;
+  double _cpu_budget = 1.0;
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::once_flag _started;
+  std::mutex _idle_lock;
+  std::condition_variable _idle;
+  std::atomic<size_t> _queued { 0 };
+
+ private:
+  MigrationPool() = default;
+  void startWorkers();
+  void workerThread(size_t id);
+  bool takeRange(size_t id, Range *range);
+  void runRange(const Range &range);
+
+ public:
+  // singleton
+  static MigrationPool& getInstance(void);
+  MigrationPool(MigrationPool const&) = delete;
+  void operator=(MigrationPool const&) = delete;
+
+  // must be called before the first migration
+  void configure(unsigned int workers_per_node, double cpu_budget);
+  size_t numWorkers() const;
+
+  // splits the pages into ranges that the workers run in parallel and waits
+  // for all of them; `node_hint` tells on which node a range should run
+  MigrationStats run(size_t page_count, size_t range_pages,
+                     const RangeFunction &fn,
+                     const std::function<int(size_t)> &node_hint);
+
+  // moves pages in parallel, each range runs next to its destination node
+  MigrationStats migrate(void *start, size_t page_count,
+                         const PageNodeFunction &node_of);
+
+  // moves the pages of a plan in parallel, expanding it one batch at a
+  // time. with before, the pages it puts on the same node stay
+  MigrationStats migrate(void *start, const PlacementPlan &plan,
+                         const PlacementPlan *before = nullptr);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MIGRATION_MIGRATIONPOOL_HPP_
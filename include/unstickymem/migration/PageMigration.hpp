@@ -0,0 +1,55 @@
+#ifndef INCLUDE_UNSTICKYMEM_MIGRATION_PAGEMIGRATION_HPP_
+#define INCLUDE_UNSTICKYMEM_MIGRATION_PAGEMIGRATION_HPP_
+
+#include <stdlib.h>
+
+#include <functional>
+
+namespace unstickymem {
+
+// default number of pages handed to each move_pages call
+static const size_t DEFAULT_MIGRATION_BATCH_PAGES = 4096;
+
+// marks a page that is already on its destination node
+static const int KEEP_PAGE = -1;
+
+// further move_pages calls for pages that were busy
+static const int MIGRATION_RETRIES = 3;
+
+// destination node of the n-th page of a range, or KEEP_PAGE to leave it
+using PageNodeFunction = std::function<int(size_t page)>;
+
+struct MigrationStats {
+  size_t pages = 0;
+  size_t kept = 0;  // pages skipped with KEEP_PAGE
+  // pages move_pages left elsewhere, e.g. still busy after the retries
+  size_t missed = 0;
+  // pages without a page frame (not faulted in yet), they fault in under
+  // the policy of their mapping
+  size_t absent = 0;
+  size_t batches = 0;
+  double seconds = 0;
+  double min_batch_rate = 0;  // slowest batch (pages/s)
+  double max_batch_rate = 0;  // fastest batch (pages/s)
+
+  double pagesPerSecond() const {
+    return seconds > 0 ? pages / seconds : 0;
+  }
+  void add(const MigrationStats &other);
+};
+
+// moves `page_count` pages starting at `start` to the nodes given by
+// `node_of`, in batches of at most `migration_batch_pages()` pages.
+// kept pages are left out of the batches, `node_of` is called once per
+// page in order. busy pages are tried again up to MIGRATION_RETRIES times,
+// the pages that still do not end up on their node count as missed.
+// the per-thread buffers are allocated once and reused between calls
+MigrationStats migrate_pages(void *start, size_t page_count,
+                             const PageNodeFunction &node_of);
+
+size_t migration_batch_pages();
+void migration_batch_pages(size_t pages);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MIGRATION_PAGEMIGRATION_HPP_
@@ -1,16 +1,38 @@
 #ifndef UNSTICKYMEM_ADAPTIVEMODE_HPP_
 #define UNSTICKYMEM_ADAPTIVEMODE_HPP_
 
+#include <limits>
+#include <string>
+
 #include "unstickymem/mode/Mode.hpp"
+#include "unstickymem/search/SearchStrategy.hpp"
 
 namespace unstickymem {
 
-class AdaptiveMode : public Mode {
- private:
+class AdaptiveMode : public Mode, public RatioEvaluator {
+ protected:
   unsigned int _wait_start;
   unsigned int _num_polls;
   unsigned int _num_poll_outliers;
   useconds_t _poll_sleep;
+  unsigned int _max_polls;
+  double _significance;
+  std::string _search;
+  double _search_resolution;
+  unsigned int _search_max_steps;
+
+  double _placed_ratio = -1;
+  double _prev_stall_rate = std::numeric_limits<double>::infinity();
+  double _best_stall_rate = std::numeric_limits<double>::infinity();
+
+  // whether no neighbour of a ratio from an earlier run does better
+  bool validateRatio(double ratio, const SearchSpace &space);
+  // every ratio worth trying
+  SearchSpace searchSpace() const;
+  // searches (or re-validates the cached ratio) and places the pages at the
+  // ratio it returns
+  double findRatio();
+
  public:
   static std::string name() {
     return "adaptive";
@@ -24,6 +46,12 @@ class AdaptiveMode : public Mode {
     return std::make_unique<AdaptiveMode>();
   }
 
+  // places all pages at the local ratio and measures the stall rate
+  StallStats evaluate(double ratio, double effort);
+  // samples more until current differs significantly from other or the
+  // measurement reaches _max_polls
+  StallComparison compare(StallStats *current, const StallStats &other);
+
   po::options_description getOptions();
   void printParameters();
   void adaptiveThread();
@@ -0,0 +1,46 @@
+#ifndef UNSTICKYMEM_CONTINUOUSMODE_HPP_
+#define UNSTICKYMEM_CONTINUOUSMODE_HPP_
+
+#include <string>
+
+#include "unstickymem/mode/AdaptiveMode.hpp"
+
+namespace unstickymem {
+
+// adaptive mode that keeps watching the stall rate after the search and
+// searches again around the current ratio when the workload changes phase
+class ContinuousMode : public AdaptiveMode {
+ private:
+  double _change_delta;
+  double _change_threshold;
+  unsigned int _min_dwell;
+  double _research_radius;
+
+  // stall rate over a short window
+  double observe();
+  // bounded search around ratio, the result only replaces ratio when it
+  // does significantly better
+  double readapt(double ratio);
+
+ public:
+  static std::string name() {
+    return "continuous";
+  }
+
+  static std::string description() {
+    return "Adaptive mode that re-adapts when the workload changes phase";
+  }
+
+  static std::unique_ptr<Mode> createInstance() {
+    return std::make_unique<ContinuousMode>();
+  }
+
+  po::options_description getOptions();
+  void printParameters();
+  void continuousThread();
+  void start();
+};
+
+}  // namespace unstickymem
+
+#endif  // UNSTICKYMEM_CONTINUOUSMODE_HPP_
@@ -36,6 +36,12 @@ class Mode {
   virtual void processSegmentRemoval(const MemorySegment& segment) {
   }
 
+  // nodes to interleave new segments on until processSegmentAddition runs
+  // for them, nullptr leaves the allocating thread's policy alone
+  virtual struct bitmask* firstTouchNodes() {
+    return nullptr;
+  }
+
   static void registerMode(std::string const & name, Description desc) {
     // disallow replacing entries
     DIEIF(registry().count(name) == 1, "Mode already registered");
@@ -35,6 +35,7 @@ class ScanMode : public Mode {
   void start();
   void startMemInit();
   void processSegmentAddition(const MemorySegment& segment);
+  struct bitmask* firstTouchNodes();
 };
 
 }  // namespace unstickymem
@@ -0,0 +1,67 @@
+#ifndef INCLUDE_UNSTICKYMEM_MODE_SEGMENTTUNINGMODE_HPP_
+#define INCLUDE_UNSTICKYMEM_MODE_SEGMENTTUNINGMODE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "unstickymem/mode/Mode.hpp"
+#include "unstickymem/counters/StallRateSampler.hpp"
+
+namespace unstickymem {
+
+// tunes the placement of the largest segments independently: each one has
+// its own mix between the local and the bandwidth weights, and a round of
+// coordinate descent probes a step either way on one segment at a time
+// while the others stay put
+class SegmentTuningMode : public Mode {
+ private:
+  unsigned int _wait_start;
+  unsigned int _num_polls;
+  unsigned int _num_poll_outliers;
+  useconds_t _poll_sleep;
+  unsigned int _max_polls;
+  double _significance;
+  unsigned int _top_segments;
+  double _step;
+  double _min_step;
+  unsigned int _max_rounds;
+
+  std::vector<double> _local_weights;
+  std::vector<double> _bandwidth_weights;
+
+  // weights of a segment at a mix, per node id
+  std::vector<double> weights(double mix) const;
+  // moves the pages of a segment to a mix and stores its tuning, the rest
+  // is refreshed from the memory map first. false if the segment is gone,
+  // or changed while its pages moved (the memory map places what replaced
+  // it again)
+  bool place(MemorySegment *segment, double mix);
+  StallStats measure();
+  // one coordinate step on a segment, returns whether it moved
+  bool tuneSegment(void *start, StallStats *current);
+
+ public:
+  static std::string name() {
+    return "segments";
+  }
+
+  static std::string description() {
+    return "Tune the placement of the largest segments independently";
+  }
+
+  static std::unique_ptr<Mode> createInstance() {
+    return std::make_unique<SegmentTuningMode>();
+  }
+
+  po::options_description getOptions();
+  void printParameters();
+  void tuningThread();
+  void start();
+  void startMemInit();
+  void processSegmentAddition(const MemorySegment& segment);
+  struct bitmask* firstTouchNodes();
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MODE_SEGMENTTUNINGMODE_HPP_
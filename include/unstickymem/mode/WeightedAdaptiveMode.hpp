@@ -4,16 +4,21 @@
 #include <string>
 
 #include "unstickymem/mode/Mode.hpp"
+#include "unstickymem/search/WeightTuner.hpp"
 
 namespace unstickymem {
 
-class WeightedAdaptiveMode : public Mode {
+class WeightedAdaptiveMode : public Mode, public WeightEvaluator {
  private:
   bool _started = false;
   unsigned int _wait_start;
   unsigned int _num_polls;
   unsigned int _num_poll_outliers;
   useconds_t _poll_sleep;
+  unsigned int _max_polls;
+  double _significance;
+  bool _tune_weights;
+  WeightTunerParameters _tuner;
  public:
   static std::string name() {
     return "wadaptive";
@@ -27,6 +32,13 @@ class WeightedAdaptiveMode : public Mode {
     return std::make_unique<WeightedAdaptiveMode>();
   }
 
+  // places all pages with the weights and measures the stall rate
+  StallStats evaluate(const std::vector<double> &weights);
+  void place(const std::vector<double> &weights);
+  // samples more until current differs significantly from other or the
+  // measurement reaches _max_polls
+  StallComparison compare(StallStats *current, const StallStats &other);
+
   po::options_description getOptions();
   void printParameters();
   void adaptiveThread();
@@ -34,6 +46,7 @@ class WeightedAdaptiveMode : public Mode {
   void startMemInit();
   void memInitThread();
   void processSegmentAddition(const MemorySegment& segment);
+  struct bitmask* firstTouchNodes();
 };
 
 }  // namespace unstickymem
@@ -0,0 +1,42 @@
+#ifndef INCLUDE_UNSTICKYMEM_NUMA_LINUXNUMA_HPP_
+#define INCLUDE_UNSTICKYMEM_NUMA_LINUXNUMA_HPP_
+
+#include <string>
+
+#include "unstickymem/numa/NumaBackend.hpp"
+
+namespace unstickymem {
+
+// the machine we run on, through libnuma and the real system calls
+class LinuxNuma : public NumaBackend {
+ public:
+  static std::string name() {
+    return "linux";
+  }
+
+  static std::string description() {
+    return "libnuma and the NUMA system calls";
+  }
+
+  static std::unique_ptr<NumaBackend> createInstance() {
+    return std::make_unique<LinuxNuma>();
+  }
+
+  int configuredNodes();
+  int maxNode();
+  bool nodeExists(int node);
+  int nodeOfCpu(int cpu);
+  int distance(int from, int to);
+  bool hasMemory(int node);
+  struct bitmask *runNodes();
+  struct bitmask *parseNodes(const char *list);
+  long bind(void *addr, unsigned long len, int mode,
+            const unsigned long *nodemask, unsigned long maxnode,
+            unsigned flags);
+  long movePages(unsigned long count, void **pages, const int *nodes,
+                 int *status, int flags);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_NUMA_LINUXNUMA_HPP_
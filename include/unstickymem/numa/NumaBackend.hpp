@@ -0,0 +1,96 @@
+#ifndef INCLUDE_UNSTICKYMEM_NUMA_NUMABACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_NUMA_NUMABACKEND_HPP_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "unstickymem/Logger.hpp"
+
+struct bitmask;
+
+namespace unstickymem {
+
+// the topology queries and page placement system calls the library makes,
+// so that they can be simulated on machines with fewer nodes
+class NumaBackend {
+  using create_f = std::unique_ptr<NumaBackend>();
+  using Description = struct {
+    create_f* create_function;
+    std::string description;
+  };
+
+ private:
+  static std::map<std::string, Description> & registry();
+
+ public:
+  virtual ~NumaBackend() = default;
+
+  // node ids go from 0 to maxNode(), configuredNodes() of them exist
+  virtual int configuredNodes() = 0;
+  virtual int maxNode() = 0;
+  virtual bool nodeExists(int node) = 0;
+  virtual int nodeOfCpu(int cpu) = 0;
+  virtual int distance(int from, int to) = 0;
+  // whether pages of the process may be placed on the node
+  virtual bool hasMemory(int node) = 0;
+  // nodes the process runs on, and a node list like "0,2-3". both return
+  // a mask to free with numa_bitmask_free, or nullptr
+  virtual struct bitmask *runNodes() = 0;
+  virtual struct bitmask *parseNodes(const char *list) = 0;
+
+  // mbind(2) and move_pages(2) of the calling process
+  virtual long bind(void *addr, unsigned long len, int mode,
+                    const unsigned long *nodemask, unsigned long maxnode,
+                    unsigned flags) = 0;
+  virtual long movePages(unsigned long count, void **pages, const int *nodes,
+                         int *status, int flags) = 0;
+
+  // bandwidth of each node (bytes/s) when it is known without probing
+  virtual bool nodeBandwidth(std::vector<double> *bandwidth) {
+    return false;
+  }
+  // the range was unmapped
+  virtual void unmapped(void *addr, size_t len) {
+  }
+
+  static void registerBackend(std::string const & name, Description desc) {
+    // disallow replacing entries
+    DIEIF(registry().count(name) == 1, "NUMA backend already registered");
+    registry()[name] = desc;
+  }
+
+  static std::unique_ptr<NumaBackend> getBackend(std::string const & name) {
+    if (registry().count(name) == 0) {
+      printAvailableBackends();
+      DIE("Please select one of the available NUMA backends");
+    }
+    return registry()[name].create_function();
+  }
+
+  static void printAvailableBackends() {
+    LWARN("Available NUMA Backends:");
+    for (auto & [name, d] : registry()) {
+      LWARNF("> %-10s (%s)", name.c_str(), d.description.c_str());
+    }
+  }
+
+  template<typename BackendImplementation>
+  struct Registrar {
+    explicit Registrar(std::string const & name,
+                       std::string const & description) {
+      NumaBackend::registerBackend(
+          name, { &BackendImplementation::createInstance, description });
+    }
+  };
+};
+
+// the backend named by $UNSTICKYMEM_NUMA (default linux), created on first
+// use. it is read from the environment because the node table is built
+// before the configuration is loaded
+NumaBackend& numa(void);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_NUMA_NUMABACKEND_HPP_
@@ -0,0 +1,131 @@
+#ifndef INCLUDE_UNSTICKYMEM_NUMA_SIMULATEDNUMA_HPP_
+#define INCLUDE_UNSTICKYMEM_NUMA_SIMULATEDNUMA_HPP_
+
+#include <stdint.h>
+
+#include <functional>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "unstickymem/numa/NumaBackend.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+// default shape of the simulated machine
+static const int DEFAULT_SIM_NODES = 4;
+static const double DEFAULT_SIM_BANDWIDTH = 10e9;      // bytes/s per node
+static const double DEFAULT_SIM_LOCAL_LATENCY = 80;    // ns
+static const double DEFAULT_SIM_REMOTE_LATENCY = 130;  // ns
+static const double DEFAULT_SIM_DEMAND = 12e9;         // bytes/s
+static const double DEFAULT_SIM_NOISE = 0.02;
+
+// allocates with the real malloc: the page table grows while placements
+// hold the segment lock, which tracked allocations would take again
+template<typename T>
+struct RealAllocator {
+  using value_type = T;
+
+  RealAllocator() = default;
+  template<typename U>
+  RealAllocator(const RealAllocator<U>&) {  // NOLINT
+  }
+
+  T* allocate(size_t n) {
+    void *p = WRAP(malloc)(n * sizeof(T));
+    if (p == nullptr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(p);
+  }
+  void deallocate(T *p, size_t) {
+    WRAP(free)(p);
+  }
+  template<typename U>
+  bool operator==(const RealAllocator<U>&) const {
+    return true;
+  }
+  template<typename U>
+  bool operator!=(const RealAllocator<U>&) const {
+    return false;
+  }
+};
+
+// a machine with any number of nodes that only exists in a page table: the
+// placement calls record which node each page is on, and the stall rate
+// and memory traffic of a bandwidth-bound workload are derived from it.
+// configured with UNSTICKYMEM_SIM_* environment variables
+class SimulatedNuma : public NumaBackend {
+ private:
+  int _nodes;
+  std::vector<double> _bandwidth;  // bytes/s of each node
+  std::vector<double> _latency;    // unloaded ns from the worker nodes
+  double _demand;  // bytes/s the workload would like to read
+  double _noise;   // relative standard deviation of the stall rate
+
+  std::mutex _lock;
+  // page number -> node
+  std::unordered_map<uintptr_t, int, std::hash<uintptr_t>,
+                     std::equal_to<uintptr_t>,
+                     RealAllocator<std::pair<const uintptr_t, int>>> _pages;
+  std::vector<size_t> _node_pages;
+  std::mt19937_64 _random;
+  size_t _failures = 0;  // pages the next moves leave where they are
+  int _failure_error = 0;
+
+ private:
+  void setNode(uintptr_t page, int node);
+
+ public:
+  static std::string name() {
+    return "sim";
+  }
+
+  static std::string description() {
+    return "Simulated nodes, for testing on any machine";
+  }
+
+  static std::unique_ptr<NumaBackend> createInstance() {
+    return std::make_unique<SimulatedNuma>();
+  }
+
+  SimulatedNuma();
+
+  int configuredNodes();
+  int maxNode();
+  bool nodeExists(int node);
+  int nodeOfCpu(int cpu);
+  int distance(int from, int to);
+  bool hasMemory(int node);
+  struct bitmask *runNodes();
+  struct bitmask *parseNodes(const char *list);
+  long bind(void *addr, unsigned long len, int mode,
+            const unsigned long *nodemask, unsigned long maxnode,
+            unsigned flags);
+  long movePages(unsigned long count, void **pages, const int *nodes,
+                 int *status, int flags);
+  bool nodeBandwidth(std::vector<double> *bandwidth);
+  void unmapped(void *addr, size_t len);
+
+  // the next count pages asked to move stay put with status -error, like
+  // pages that are not faulted in (ENOENT) or are busy (EBUSY)
+  void failMoves(size_t count, int error);
+  // node a page is recorded on, -ENOENT if it is not
+  int nodeOf(void *page);
+  // fraction of the recorded pages on each node
+  std::vector<double> pageShares();
+  // stall cycles per cycle with the pages spread by shares, without noise
+  double modelStallRate(const std::vector<double> &shares) const;
+  // bytes per second each node serves with the pages spread by shares
+  std::vector<double> modelTraffic(const std::vector<double> &shares) const;
+  // modelStallRate of the current placement, with noise
+  double stallRate();
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_NUMA_SIMULATEDNUMA_HPP_
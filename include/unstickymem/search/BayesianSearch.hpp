@@ -0,0 +1,31 @@
+#ifndef INCLUDE_UNSTICKYMEM_SEARCH_BAYESIANSEARCH_HPP_
+#define INCLUDE_UNSTICKYMEM_SEARCH_BAYESIANSEARCH_HPP_
+
+#include <string>
+
+#include "unstickymem/search/SearchStrategy.hpp"
+
+namespace unstickymem {
+
+// models the stall rate over the ratios as a Gaussian process and evaluates
+// the ratio with the highest expected improvement until none is expected
+class BayesianSearch : public SearchStrategy {
+ public:
+  static std::string name() {
+    return "bayesian";
+  }
+
+  static std::string description() {
+    return "Gaussian process model of the stall rate, expected improvement";
+  }
+
+  static std::unique_ptr<SearchStrategy> createInstance() {
+    return std::make_unique<BayesianSearch>();
+  }
+
+  double search(RatioEvaluator &evaluator, const SearchSpace &space);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_SEARCH_BAYESIANSEARCH_HPP_
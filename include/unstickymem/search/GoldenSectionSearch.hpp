@@ -0,0 +1,31 @@
+#ifndef INCLUDE_UNSTICKYMEM_SEARCH_GOLDENSECTIONSEARCH_HPP_
+#define INCLUDE_UNSTICKYMEM_SEARCH_GOLDENSECTIONSEARCH_HPP_
+
+#include <string>
+
+#include "unstickymem/search/SearchStrategy.hpp"
+
+namespace unstickymem {
+
+// narrows the interval around the optimum by the golden ratio with every
+// evaluation, assuming the stall rate has a single minimum in the interval
+class GoldenSectionSearch : public SearchStrategy {
+ public:
+  static std::string name() {
+    return "golden";
+  }
+
+  static std::string description() {
+    return "Golden-section search, assumes a single optimum";
+  }
+
+  static std::unique_ptr<SearchStrategy> createInstance() {
+    return std::make_unique<GoldenSectionSearch>();
+  }
+
+  double search(RatioEvaluator &evaluator, const SearchSpace &space);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_SEARCH_GOLDENSECTIONSEARCH_HPP_
@@ -0,0 +1,31 @@
+#ifndef INCLUDE_UNSTICKYMEM_SEARCH_LINEARSEARCH_HPP_
+#define INCLUDE_UNSTICKYMEM_SEARCH_LINEARSEARCH_HPP_
+
+#include <string>
+
+#include "unstickymem/search/SearchStrategy.hpp"
+
+namespace unstickymem {
+
+// walks the ratios from low to high in fixed steps and stops at the first
+// one that is significantly worse than the best so far
+class LinearSearch : public SearchStrategy {
+ public:
+  static std::string name() {
+    return "linear";
+  }
+
+  static std::string description() {
+    return "Step through the ratios until one is significantly worse";
+  }
+
+  static std::unique_ptr<SearchStrategy> createInstance() {
+    return std::make_unique<LinearSearch>();
+  }
+
+  double search(RatioEvaluator &evaluator, const SearchSpace &space);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_SEARCH_LINEARSEARCH_HPP_
@@ -0,0 +1,90 @@
+#ifndef INCLUDE_UNSTICKYMEM_SEARCH_SEARCHSTRATEGY_HPP_
+#define INCLUDE_UNSTICKYMEM_SEARCH_SEARCHSTRATEGY_HPP_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "unstickymem/counters/StallRateSampler.hpp"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+// places the pages at a ratio and measures it, implemented by the modes
+class RatioEvaluator {
+ public:
+  virtual ~RatioEvaluator() = default;
+
+  // moves the pages to ratio and measures the stall rate there. effort
+  // scales the number of measurements, 1 being a full window
+  virtual StallStats evaluate(double ratio, double effort) = 0;
+
+  // compares the measurement of the ratio placed last with an earlier one,
+  // sampling more while the difference is within the noise
+  virtual StallComparison compare(StallStats *current,
+                                  const StallStats &other) = 0;
+};
+
+// interval of placement ratios to search and how hard to look
+struct SearchSpace {
+  double low;
+  double high;
+  double resolution;  // ratios closer than this are not told apart
+  unsigned int max_steps;  // evaluations allowed to strategies that can stop
+                           // at any time
+};
+
+// how the adaptive modes pick the next placement ratio to evaluate
+class SearchStrategy {
+  using create_f = std::unique_ptr<SearchStrategy>();
+  using Description = struct {
+    create_f* create_function;
+    std::string description;
+  };
+
+ private:
+  static std::map<std::string, Description> & registry();
+
+ public:
+  virtual ~SearchStrategy() = default;
+
+  // evaluates ratios of the space and returns the best one found, the
+  // pages may be placed at any ratio when it returns
+  virtual double search(RatioEvaluator &evaluator,
+                        const SearchSpace &space) = 0;
+
+  static void registerStrategy(std::string const & name, Description desc) {
+    // disallow replacing entries
+    DIEIF(registry().count(name) == 1, "Search strategy already registered");
+    registry()[name] = desc;
+  }
+
+  static std::unique_ptr<SearchStrategy> getStrategy(
+      std::string const & name) {
+    if (registry().count(name) == 0) {
+      printAvailableStrategies();
+      DIE("Please select one of the available search strategies");
+    }
+    return registry()[name].create_function();
+  }
+
+  static void printAvailableStrategies() {
+    LWARN("Available Search Strategies:");
+    for (auto & [name, d] : registry()) {
+      LWARNF("> %-10s (%s)", name.c_str(), d.description.c_str());
+    }
+  }
+
+  template<typename StrategyImplementation>
+  struct Registrar {
+    explicit Registrar(std::string const & name,
+                       std::string const & description) {
+      SearchStrategy::registerStrategy(
+          name, { &StrategyImplementation::createInstance, description });
+    }
+  };
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_SEARCH_SEARCHSTRATEGY_HPP_
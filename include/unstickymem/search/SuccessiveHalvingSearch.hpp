@@ -0,0 +1,31 @@
+#ifndef INCLUDE_UNSTICKYMEM_SEARCH_SUCCESSIVEHALVINGSEARCH_HPP_
+#define INCLUDE_UNSTICKYMEM_SEARCH_SUCCESSIVEHALVINGSEARCH_HPP_
+
+#include <string>
+
+#include "unstickymem/search/SearchStrategy.hpp"
+
+namespace unstickymem {
+
+// measures a grid of ratios with short windows, then keeps re-measuring the
+// better half with windows twice as long until one ratio is left
+class SuccessiveHalvingSearch : public SearchStrategy {
+ public:
+  static std::string name() {
+    return "halving";
+  }
+
+  static std::string description() {
+    return "Measure a grid briefly, keep the better half with longer measurements";
+  }
+
+  static std::unique_ptr<SearchStrategy> createInstance() {
+    return std::make_unique<SuccessiveHalvingSearch>();
+  }
+
+  double search(RatioEvaluator &evaluator, const SearchSpace &space);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_SEARCH_SUCCESSIVEHALVINGSEARCH_HPP_
@@ -0,0 +1,58 @@
+#ifndef INCLUDE_UNSTICKYMEM_SEARCH_WEIGHTTUNER_HPP_
+#define INCLUDE_UNSTICKYMEM_SEARCH_WEIGHTTUNER_HPP_
+
+#include <vector>
+
+#include "unstickymem/counters/StallRateSampler.hpp"
+
+namespace unstickymem {
+
+// places the pages with a weight vector and measures it, implemented by
+// the modes
+class WeightEvaluator {
+ public:
+  virtual ~WeightEvaluator() = default;
+
+  // moves the pages to the weights (per node id, summing up to 100) and
+  // measures the stall rate there
+  virtual StallStats evaluate(const std::vector<double> &weights) = 0;
+
+  // moves the pages to the weights without measuring
+  virtual void place(const std::vector<double> &weights) = 0;
+
+  // compares the measurement of the weights placed last with an earlier
+  // one, sampling more while the difference is within the noise
+  virtual StallComparison compare(StallStats *current,
+                                  const StallStats &other) = 0;
+};
+
+struct WeightTunerParameters {
+  double step = 5;       // weight points moved by the first steps
+  double min_step = 1;   // the descent stops below this step
+  unsigned int max_iterations = 10;
+};
+
+// gradient descent on the per-node weights: each iteration probes every
+// node with a little more weight to estimate the partial derivatives of
+// the stall rate, then steps against the gradient, halving the step when
+// the stall rate does not go down
+class WeightTuner {
+ private:
+  WeightTunerParameters _parameters;
+  std::vector<bool> _tunable;  // nodes that can hold memory
+
+  // clamps to the tunable nodes and scales the weights to sum up to 100
+  std::vector<double> normalize(std::vector<double> weights) const;
+
+ public:
+  explicit WeightTuner(const WeightTunerParameters &parameters);
+
+  // returns the best weights found, starting from weights. the pages are
+  // placed with the returned weights
+  std::vector<double> tune(WeightEvaluator &evaluator,
+                           std::vector<double> weights);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_SEARCH_WEIGHTTUNER_HPP_
@@ -2,6 +2,7 @@
 #define UNSTICKYMEM_H_
 
 #include <stdio.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 // check whether a monitoring core has been passed
@@ -12,10 +13,13 @@ extern "C" {
 extern int PMC_VALUE;
 // the number of worker nodes
 extern int OPT_NUM_WORKERS_VALUE;
+// the worker nodes, i.e., the nodes the application threads run on
+struct bitmask;
+extern struct bitmask *WORKER_NODES;
 // the monitoring core
 extern int MONITORING_CORE_VALUE;
-// Maximum number of nodes in the system
-#define MAX_NODES 2
+// Number of NUMA nodes in the system (detected at startup)
+extern int NUM_NODES;
 // A structure to hold the nodes information
 typedef struct rec {
   int id;
@@ -23,8 +27,8 @@ typedef struct rec {
   int count;
 } RECORD;
 
-// hold the nodes information ids and weights
-extern RECORD nodes_info[MAX_NODES];
+// hold the nodes information ids and weights (NUM_NODES entries)
+extern RECORD *nodes_info;
 // sum of worker nodes weights
 extern double sum_ww;
 // sum of non-worker nodes weights
@@ -35,13 +39,20 @@ extern double sum_nww;
 
 extern int MEM_INIT;
 
-int check_sum(RECORD nodes_info[MAX_NODES]);
+int check_sum(RECORD *nodes_info);
 void unstickymem_nop(void);
 void unstickymem_start(void);
 void unstickymem_initialize(void);
 void unstickymem_print_memory(void);
+// reports that the calling thread completed ops units of work, for the
+// progress objective. takes no lock and makes no system call
+void unstickymem_report_progress(uint64_t ops);
+// the calling thread's progress counter, hot loops may add to it directly
+// with __atomic_fetch_add(counter, ops, __ATOMIC_RELAXED)
+uint64_t *unstickymem_progress_counter(void);
 void read_weights(char filename[]);
-void get_sum_nww_ww(int num_workers);
+int is_worker_node(int node);
+void get_sum_nww_ww(void);
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -0,0 +1,152 @@
+#include <sched.h>
+#include <sys/mman.h>
+#include <string.h>
+
+#include <numa.h>
+#include <numaif.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+#include "unstickymem/BandwidthProbe.hpp"
+#include "unstickymem/unstickymem.h"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+// cpus of the worker nodes that the process may run on
+static std::vector<int> worker_cpus(void) {
+  std::vector<int> cpus;
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  DIEIF(sched_getaffinity(0, sizeof(allowed), &allowed) < 0,
+        "could not read the cpu affinity");
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed)
+        && numa_bitmask_isbitset(WORKER_NODES, numa_node_of_cpu(cpu))) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// streams through the buffer until told to stop, returns the bytes read
+static uint64_t stream_read(const uint64_t *buffer, size_t words,
+                            const std::atomic<bool> &stop) {
+  uint64_t bytes = 0;
+  uint64_t sum = 0;
+  while (!stop.load(std::memory_order_relaxed)) {
+    for (size_t i = 0; i < words; i += 8) {
+      sum += buffer[i] + buffer[i + 1] + buffer[i + 2] + buffer[i + 3]
+          + buffer[i + 4] + buffer[i + 5] + buffer[i + 6] + buffer[i + 7];
+    }
+    bytes += words * sizeof(*buffer);
+  }
+  // keep the loads from being optimized away
+  volatile uint64_t sink = sum;
+  (void) sink;
+  return bytes;
+}
+
+static double probe_node(int node, const std::vector<int> &cpus,
+                         size_t buffer_size, double seconds) {
+  std::atomic<size_t> ready { 0 };
+  std::atomic<bool> go { false };
+  std::atomic<bool> stop { false };
+  std::atomic<uint64_t> bytes { 0 };
+
+  struct bitmask *nodemask = numa_allocate_nodemask();
+  numa_bitmask_setbit(nodemask, node);
+
+  std::vector<std::thread> threads;
+  for (int cpu : cpus) {
+    threads.emplace_back([&, cpu] {
+      cpu_set_t mask;
+      CPU_ZERO(&mask);
+      CPU_SET(cpu, &mask);
+      sched_setaffinity(0, sizeof(mask), &mask);
+
+      void *buffer = WRAP(mmap)(nullptr, buffer_size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      DIEIF(buffer == MAP_FAILED, "error allocating the probe buffer");
+      DIEIF(WRAP(mbind)(buffer, buffer_size, MPOL_BIND, nodemask->maskp,
+                        nodemask->size + 1, 0) != 0,
+            "mbind of the probe buffer failed");
+      memset(buffer, 1, buffer_size);
+
+      ready++;
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      bytes += stream_read(reinterpret_cast<uint64_t*>(buffer),
+                           buffer_size / sizeof(uint64_t), stop);
+      WRAP(munmap)(buffer, buffer_size);
+    });
+  }
+
+  // time the window in which all threads read
+  while (ready.load() < cpus.size()) {
+    std::this_thread::yield();
+  }
+  auto start = std::chrono::steady_clock::now();
+  go = true;
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  numa_free_nodemask(nodemask);
+  return bytes / elapsed;
+}
+
+std::vector<double> measure_node_bandwidth(size_t buffer_size,
+                                           double seconds) {
+  std::vector<double> bandwidth;
+  if (numa().nodeBandwidth(&bandwidth)) {
+    return bandwidth;
+  }
+
+  std::vector<int> cpus = worker_cpus();
+  DIEIF(cpus.empty(), "no cpus on the worker nodes to probe from");
+
+  // indexed by node id, the ids may have gaps
+  bandwidth.assign(numa().maxNode() + 1, 0);
+  for (int i = 0; i < NUM_NODES; i++) {
+    int node = nodes_info[i].id;
+    long long free_memory = 0;
+    if (numa_node_size64(node, &free_memory) <= 0) {
+      continue;
+    }
+    // leave most of the free memory of the node alone
+    size_t size = std::min<size_t>(buffer_size,
+                                   free_memory / 4 / cpus.size());
+    size = size & ~(size_t) 63;
+    if (size == 0) {
+      LWARNF("node %d has too little free memory to be probed", node);
+      continue;
+    }
+    bandwidth[node] = probe_node(node, cpus, size, seconds);
+    LINFOF("node %d: %.2lf GB/s from %zu worker cpus", node,
+           bandwidth[node] / 1e9, cpus.size());
+  }
+  return bandwidth;
+}
+
+std::vector<double> bandwidth_weights(const std::vector<double> &bandwidth) {
+  double total = std::accumulate(bandwidth.begin(), bandwidth.end(), 0.0);
+  DIEIF(total <= 0, "no bandwidth measured on any node");
+  std::vector<double> weights;
+  for (double b : bandwidth) {
+    weights.push_back(b / total * 100);
+  }
+  return weights;
+}
+
+}  // namespace unstickymem
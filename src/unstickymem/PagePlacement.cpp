@@ -1,22 +1,30 @@
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
 #include <errno.h>
 
 #include <time.h>
 
+#include <algorithm>
+#include <atomic>
 #include <numeric>
 #include <iostream>
 #include <cmath>
 #include <random>
+#include <vector>
 
 #include "unstickymem/unstickymem.h"
 #include "unstickymem/Logger.hpp"
 #include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/PlacementPlan.hpp"
 #include "unstickymem/wrap.hpp"
+#include "unstickymem/migration/MigrationPool.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
 
-static int pagesize;
+static bool huge_pages = false;
+static size_t granularity_pages = 1;
 
-RECORD nodes_info_temp[MAX_NODES];
+std::vector<RECORD> nodes_info_temp;
 int weight_initialized = 0;
 
 namespace unstickymem {
@@ -48,29 +56,234 @@ void print_node_allocations() {
   printf("\x1B[0m");
 }
 
+// nodes with a non-zero weight. a new mask replaces it when the weights
+// change, the old ones are kept since a first-touch policy may still be
+// reading them
+static std::atomic<struct bitmask*> weighted_nodemask { nullptr };
+
+static struct bitmask *build_weighted_nodes_nodemask(void) {
+  struct bitmask *weighted = numa_allocate_nodemask();
+  for (int i = 0; i < NUM_NODES; i++) {
+    if (nodes_info[i].weight > 0) {
+      numa_bitmask_setbit(weighted, nodes_info[i].id);
+    }
+  }
+  weighted_nodemask.store(weighted, std::memory_order_release);
+  return weighted;
+}
+
+struct bitmask *weighted_nodes_nodemask(void) {
+  struct bitmask *nodemask = weighted_nodemask.load(std::memory_order_acquire);
+  return nodemask != nullptr ? nodemask : build_weighted_nodes_nodemask();
+}
+
+void node_weights_changed(void) {
+  build_weighted_nodes_nodemask();
+  // the dwp placers derive their weights again
+  weight_initialized = 0;
+}
+
+void huge_page_placement(bool enabled) {
+  huge_pages = enabled;
+}
+
+bool huge_page_placement() {
+  return huge_pages;
+}
+
+size_t huge_page_size() {
+  static size_t size = 0;
+  if (size == 0) {
+    size_t hpage_size = 0;
+    FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+    if (f != nullptr) {
+      if (fscanf(f, "%zu", &hpage_size) != 1) {
+        hpage_size = 0;
+      }
+      fclose(f);
+    }
+    size = hpage_size > 0 ? hpage_size : DEFAULT_HUGE_PAGE_SIZE;
+  }
+  return size;
+}
+
+void placement_granularity(size_t pages) {
+  DIEIF(pages == 0, "placement stripes must have at least one page");
+  granularity_pages = pages;
+}
+
+size_t placement_granularity() {
+  return granularity_pages;
+}
+
+size_t parse_granularity(const std::string &spec) {
+  size_t pagesize = numa_pagesize();
+  if (spec == "page") {
+    return 1;
+  }
+  if (spec == "huge") {
+    return huge_page_size() / pagesize;
+  }
+  // a number of pages, or a size with a K, M or G suffix
+  char *end;
+  unsigned long long value = strtoull(spec.c_str(), &end, 10);
+  if (end == spec.c_str() || value == 0) {
+    return 0;
+  }
+  std::string suffix(end);
+  if (suffix.empty()) {
+    return value;
+  }
+  size_t shift = suffix == "K" || suffix == "k" ? 10 :
+      suffix == "M" || suffix == "m" ? 20 : suffix == "G" || suffix == "g" ?
+      30 : 0;
+  if (shift == 0 || (value << shift) % pagesize != 0) {
+    return 0;
+  }
+  return (value << shift) / pagesize;
+}
+
+size_t placement_unit_pages() {
+  if (!huge_pages) {
+    return granularity_pages;
+  }
+  // stripes of whole huge pages
+  size_t hpage_pages = huge_page_size() / numa_pagesize();
+  return (granularity_pages + hpage_pages - 1) / hpage_pages * hpage_pages;
+}
+
+void advise_huge_pages(const MemorySegment &segment) {
+  if (!huge_pages || segment.pageAlignedLength() < huge_page_size()) {
+    return;
+  }
+  // e.g. file mappings, or THP disabled system-wide
+  if (madvise(segment.pageAlignedStartAddress(), segment.pageAlignedLength(),
+              MADV_HUGEPAGE) != 0) {
+    LDEBUGF("no huge pages for %s [%p:%p]", segment.name().c_str(),
+            segment.startAddress(), segment.endAddress());
+  }
+}
+
+//units of the placement granularity over a range
+static UnitLayout unit_layout(void *start, size_t page_count) {
+  return unit_layout(start, page_count, placement_unit_pages());
+}
+
+//mbind that moves the pages already there. segments are placed without the
+//segment lock, a range unmapped in the meantime is skipped
+static void bind_pages(void *addr, unsigned long len, int mode,
+                       const unsigned long *nodemask, unsigned long maxnode) {
+  if (numa().bind(addr, len, mode, nodemask, maxnode,
+                  MPOL_MF_MOVE | MPOL_MF_STRICT) == 0) {
+    return;
+  }
+  DIEIF(errno != EFAULT && errno != ENOMEM, "mbind error");
+  LDEBUGF("range [%p:+%lu] was unmapped before its placement", addr, len);
+}
+
+//applies a plan with mbind: runs are bound to their node, stripes dealing
+//single pages to distinct nodes are left to the kernel's interleave, and
+//the other stripes are bound one run of units at a time. the interleave
+//gives every node its share of the stripe, but in the kernel's order (by
+//the page's offset in its mapping, nodes ascending) rather than the plan's,
+//so a segment placed this way does not have a known placement
+//(see apply_placement)
+static void bind_plan(void *addr, const PlacementPlan &plan) {
+  const UnitLayout &layout = plan.layout();
+  char *start = reinterpret_cast<char*>(addr);
+  struct bitmask *nodemask = numa_allocate_nodemask();
+
+  //first page of a unit within the range
+  auto page_of = [&](size_t unit) {
+    return std::min(std::max(unit * layout.unit, layout.lead) - layout.lead,
+                    layout.pages);
+  };
+  auto bind = [&](size_t first, size_t last, int mode) {
+    if (last > first) {
+      bind_pages(start + first * numa_pagesize(),
+                 (last - first) * numa_pagesize(), mode, nodemask->maskp,
+                 nodemask->size + 1);
+    }
+  };
+
+  for (const PlanStripe &stripe : plan.stripes()) {
+    size_t end = stripe.first + stripe.units;
+    std::vector<int> nodes(stripe.pattern);
+    std::sort(nodes.begin(), nodes.end());
+    bool distinct = std::adjacent_find(nodes.begin(), nodes.end())
+        == nodes.end();
+    if (nodes.size() == 1 || (layout.unit == 1 && distinct)) {
+      numa_bitmask_clearall(nodemask);
+      for (int node : nodes) {
+        numa_bitmask_setbit(nodemask, node);
+      }
+      bind(page_of(stripe.first), page_of(end),
+           nodes.size() == 1 ? MPOL_BIND : MPOL_INTERLEAVE);
+      continue;
+    }
+    size_t first = stripe.first;
+    while (first < end) {
+      int node = plan.nodeOf(first);
+      size_t last = first + 1;
+      while (last < end && plan.nodeOf(last) == node) {
+        last++;
+      }
+      numa_bitmask_clearall(nodemask);
+      numa_bitmask_setbit(nodemask, node);
+      bind(page_of(first), page_of(last), MPOL_BIND);
+      first = last;
+    }
+  }
+  numa_bitmask_free(nodemask);
+}
+
+//weights of a node table, indexed by node id (the ids may have gaps)
+static std::vector<double> record_weights(const RECORD *records) {
+  std::vector<double> weights(numa().maxNode() + 1, 0);
+  for (int i = 0; i < NUM_NODES; i++) {
+    weights[records[i].id] = records[i].weight;
+  }
+  return weights;
+}
+
 void place_on_node(char *addr, unsigned long len, int node) {
-  DIEIF(node < 0 || node >= numa_num_configured_nodes(),
+  DIEIF(node < 0 || node > numa().maxNode() || !numa().nodeExists(node),
         "invalid NUMA node id");
-  struct bitmask *nodemask = numa_bitmask_alloc(numa_num_configured_nodes());
+  struct bitmask *nodemask = numa_allocate_nodemask();
   numa_bitmask_setbit(nodemask, node);
-  DIEIF(
-      WRAP(mbind)(addr, len, MPOL_BIND, nodemask->maskp, nodemask->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-      "mbind error");
+  bind_pages(addr, len, MPOL_BIND, nodemask->maskp, nodemask->size + 1);
+  numa_bitmask_free(nodemask);
 }
 
 void force_uniform_interleave(char *addr, unsigned long len) {
-  const size_t len_per_call = 64 * PAGE_SIZE;
-  int num_nodes = numa_num_configured_nodes();
+  // the node ids may have gaps
+  std::vector<int> node_ids;
+  std::vector<double> weights(numa().maxNode() + 1, 0);
+  for (int node = 0; node <= numa().maxNode(); node++) {
+    if (numa().nodeExists(node)) {
+      node_ids.push_back(node);
+      weights[node] = 1;
+    }
+  }
+  int num_nodes = node_ids.size();
 
   // validate input
   DIEIF(len % PAGE_SIZE != 0,
         "Size of region must be a multiple of the page size");
 
+  // stripes of the placement granularity, aligned to their size
+  if (placement_unit_pages() > 1) {
+    bind_plan(addr, PlacementPlan::interleaved(
+        unit_layout(addr, len / numa_pagesize()), weights));
+    return;
+  }
+  const size_t len_per_call = 64 * PAGE_SIZE;
+
   // compute nodemasks for each node
   std::vector<struct bitmask *> nodemasks(num_nodes);
   for (int i = 0; i < num_nodes; i++) {
-    nodemasks[i] = numa_bitmask_alloc(num_nodes);
-    numa_bitmask_setbit(nodemasks[i], i);
+    nodemasks[i] = numa_allocate_nodemask();
+    numa_bitmask_setbit(nodemasks[i], node_ids[i]);
   }
 
   // interleave all pages through all nodes
@@ -80,9 +293,8 @@ void force_uniform_interleave(char *addr, unsigned long len) {
     /*LTRACEF("mbind(%p, %lu, MPOL_BIND, 0x%x, %d, MPOL_MF_MOVE | MPOL_MF_STRICT)",
      addr, mbind_len, *(nodemasks[node_to_bind]->maskp),
      nodemasks[node_to_bind]->size + 1);*/
-    DIEIF(
-        WRAP(mbind)(addr, mbind_len, MPOL_BIND, nodemasks[node_to_bind]->maskp, nodemasks[node_to_bind]->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-        "mbind error");
+    bind_pages(addr, mbind_len, MPOL_BIND, nodemasks[node_to_bind]->maskp,
+               nodemasks[node_to_bind]->size + 1);
     addr += mbind_len;
     len -= mbind_len;
     node_to_bind = (node_to_bind + 1) % num_nodes;
@@ -151,244 +363,124 @@ void force_uniform_interleave(MemorySegment &segment) {
  LINFO("All pages have been faulted!");
  }*/
 
-//place pages with the move_pages system call
-//courtesy: https://stackoverflow.com/questions/10989169/numa-memory-page-migration-overhead/11148999
-void move_pages_remote(void *start, unsigned long len, double remote_ratio) {
-
-  pagesize = numa_pagesize();
-
-  char *pages;
-
-  int i, rc;
-
-  void **addr;
-  int *status;
-  int *nodes;
-
-  int page_count = len / pagesize;
-
-  double interleaved_pages;
-  int remote_node, local_node;
+//plan of move_pages_remote: uniform distribution memory allocation (using
+//the bwap style format) between the worker and the other nodes
+static PlacementPlan remote_ratio_plan(const UnitLayout &layout,
+                                       double remote_ratio) {
+  //set the remote and local nodes here
+  std::vector<int> local_nodes, remote_nodes;
+  for (int i = 0; i < NUM_NODES; i++) {
+    if (is_worker_node(nodes_info[i].id)) {
+      local_nodes.push_back(nodes_info[i].id);
+    } else {
+      remote_nodes.push_back(nodes_info[i].id);
+    }
+  }
+  if (remote_nodes.empty()) {
+    remote_nodes = local_nodes;
+  }
+  return PlacementPlan::remoteRatio(layout, remote_ratio, local_nodes,
+                                    remote_nodes);
+}
 
-  addr = (void **) malloc(sizeof(char *) * page_count);
-  status = (int *) malloc(page_count * sizeof(int *));
-  nodes = (int *) malloc(page_count * sizeof(int *));
+static MigrationStats migrate_plan(void *start, const PlacementPlan &plan,
+                                   const PlacementPlan *before = nullptr) {
+  DIEIF(start == nullptr, "cannot move pages of a null segment");
+  MigrationStats stats =
+      MigrationPool::getInstance().migrate(start, plan, before);
+  LDEBUGF("moved %zu pages (%zu kept) in %zu batches with a plan of %zu "
+          "stripes: %.3lfs (%.0lf pages/s, slowest batch %.0lf pages/s)",
+          stats.pages, stats.kept, stats.batches, plan.stripes().size(),
+          stats.seconds, stats.pagesPerSecond(), stats.min_batch_rate);
+  return stats;
+}
 
-  if (!start || !addr || !status || !nodes) {
-    LINFO("Unable to allocate memory");
-    exit(1);
+//plan of a placement applied with move_pages
+static PlacementPlan placement_plan(const SegmentPlacement &placement) {
+  UnitLayout layout = unit_layout(placement.start, placement.pages);
+  if (!placement.weights.empty()) {
+    return PlacementPlan::spread(layout, placement.weights);
   }
+  return remote_ratio_plan(layout, placement.remote_ratio);
+}
 
-  pages = (char *) start;
+//place pages with the move_pages system call
+//courtesy: https://stackoverflow.com/questions/10989169/numa-memory-page-migration-overhead/11148999
+void move_pages_remote(void *start, unsigned long len, double remote_ratio) {
+  migrate_plan(start, remote_ratio_plan(
+      unit_layout(start, len / numa_pagesize()), remote_ratio));
+}
 
-  //set the remote and local nodes here
-  if (OPT_NUM_WORKERS_VALUE == 2) {
-    remote_node = 0;
-    local_node = 0;
-  } else {
-    remote_node = 0;
-    local_node = 0;
+//move only the pages whose node differs from the last placement applied to
+//the segment, or all of them if that placement is unknown. busy pages are
+//retried by the migration, pages that are not faulted in yet follow the
+//policy of their mapping when they are
+static void apply_placement(MemorySegment &segment,
+                            SegmentPlacement placement) {
+  void *start = segment.pageAlignedStartAddress();
+  size_t page_count = segment.pageAlignedLength() / numa_pagesize();
+  const SegmentPlacement &last = segment.placement();
+  placement.start = start;
+  placement.pages = page_count;
+
+  PlacementPlan after = placement_plan(placement);
+  MigrationStats stats;
+  if (!last.known() || last.start != start) {
+    stats = migrate_plan(start, after);
+  } else if (last.pages != page_count
+      || last.remote_ratio != placement.remote_ratio
+      || last.weights != placement.weights) {
+    PlacementPlan before = placement_plan(last);
+    stats = migrate_plan(start, after, &before);
   }
+  if (stats.missed > 0) {
+    LDEBUGF("%zu pages of [%p:%p] did not move", stats.missed,
+            segment.startAddress(), segment.endAddress());
+  }
+  segment.placement(placement);
+}
 
-  //uniform distribution memory allocation (using the bwap style format)
-  if (remote_ratio <= 50) {
-    interleaved_pages = (remote_ratio / 100 * (double) page_count) * MAX_NODES;
-    //LINFOF("page_count:%d interleaved_pages:%d", page_count, (int) interleaved_pages);
-    for (i = 0; i < page_count; ++i) {
-      addr[i] = pages + i * pagesize;
-      if (i < interleaved_pages) {
-        if (i % 2 == 0) {
-          nodes[i] = local_node;
-        } else {
-          nodes[i] = remote_node;
-        }
-      } else {
-        nodes[i] = local_node;
-      }
-      status[i] = -123;
-    }
-
-    rc = move_pages(0, page_count, addr, nodes, status, MPOL_MF_MOVE);
-    if (rc < 0 && errno != ENOENT) {
-      perror("move_pages");
-      exit(1);
-    }
+void move_pages_remote(MemorySegment &segment, double remote_ratio) {
+  SegmentPlacement placement;
+  placement.remote_ratio = remote_ratio;
+  apply_placement(segment, placement);
+}
 
-  } else {
-    interleaved_pages = ((100 - remote_ratio) / 100 * (double) page_count)
-        * MAX_NODES;
-    //LINFOF("page_count:%d interleaved_pages:%d", page_count, (int) interleaved_pages);
-    for (i = 0; i < page_count; ++i) {
-      addr[i] = pages + i * pagesize;
-      if (i < interleaved_pages) {
-        if (i % 2 == 0) {
-          nodes[i] = local_node;
-        } else {
-          nodes[i] = remote_node;
-        }
-      } else {
-        nodes[i] = remote_node;
-      }
-      status[i] = -123;
-    }
+void move_pages_weighted(MemorySegment &segment,
+                         const std::vector<double> &weights) {
+  SegmentPlacement placement;
+  placement.weights = weights;
+  apply_placement(segment, placement);
+}
 
-    rc = move_pages(0, page_count, addr, nodes, status, MPOL_MF_MOVE);
-    if (rc < 0 && errno != ENOENT) {
-      perror("move_pages");
-      exit(1);
+void place_segments(MemoryMap &segments, size_t min_length,
+                    const std::function<void(MemorySegment&)> &place) {
+  for (void *start : segments.largestSegments(SIZE_MAX, min_length)) {
+    MemorySegment segment(start, start, "");
+    if (!segments.copySegment(start, &segment)) {
+      continue;  // freed since
     }
+    place(segment);
+    segments.updateSegment(segment);
   }
+}
 
-  //Move pages
-  //LINFOF("move_pages....(%d pages)", page_count);
-  //pid_t pid = getpid(); //pid of the current process!
-  /*rc = move_pages(0, page_count, addr, nodes, status, MPOL_MF_MOVE);
-   if (rc < 0 && errno != ENOENT) {
-   perror("move_pages");
-   exit(1);
-   }*/
-
-  //return if the segment is not initialized!
-  //check this by moving 1 page and checking the status of the page
-  /*addr[0] = pages;
-   nodes[0] = local_node;
-   status[0] = -123;
-   rc = numa_move_pages(0, 1, addr, NULL, status, 0);
-   //LINFOF("rc=%d vaddr=%p node=%d status=%d", rc, addr[0], nodes[0], status[0]);
-   if (rc < 0 && errno != ENOENT) {
-   perror("move_pages");
-   exit(1);
-   }
-
-   //LINFOF("Segment status=%d", status[0]);
-   if (status[0] == remote_node){
-   LINFOF("Returning, segment seems to have been moved before, status=%d", status[0]);
-   return;
-   }*/
-
-  //contiguous memory allocation
-  /*struct timeval tval_before, tval_after, tval_result;
-   gettimeofday(&tval_before, NULL);
-   for (i = 0; i < page_count; ++i) {
-   addr[i] = pages + i * pagesize;
-   if (i < moved_pages){
-   nodes[i] = remote_node;
-   }
-   else{
-   nodes[i] = local_node;
-   }
-   status[i] = -123;
-   }
-   gettimeofday(&tval_after, NULL);
-   timersub(&tval_after, &tval_before, &tval_result);
-   LINFOF("Elapsed time (seconds) to process the nodes of this segment(pages=%d): %ld.%06ld", page_count, (long int)tval_result.tv_sec, (long int)tval_result.tv_usec);
-   */
-  //uniform distribution memory allocation (using a uniform random generator!)
-  /*const int range_from = 0;
-   const int range_to = page_count;
-   std::random_device rand_dev;
-   std::mt19937 generator(rand_dev());
-   std::uniform_int_distribution<int> distr(range_from, range_to);
-
-   for (i = 0; i < page_count; ++i){
-   addr[i] = pages + i * pagesize;
-   int check_page = distr(generator);
-   if (check_page < moved_pages){
-   nodes[i] = remote_node;
-   }
-   else{
-   nodes[i] = local_node;
-   }
-   status[i] = -123;
-   }*/
-
-  //try mbind if possible, to bind the pages that have not been allocated yet!
-  /* struct bitmask *node_set = numa_bitmask_alloc(MAX_NODES);  // numa_allocate_nodemask();
-   numa_bitmask_setall(node_set);
-
-   DIEIF(
-   WRAP(mbind)(start, (moved_pages * pagesize), MPOL_INTERLEAVE, node_set->maskp, node_set->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-   "mbind interleave failed");*/
-
-  /*LINFO("Verifying after pages have been moved");
-   for( i = 0; i < page_count; i++){
-   //LINFOF("Page %d vaddr=%p status=%d", i, page_base + i * pagesize, status[i]);
-   if (status[i] != 1) {
-   LINFOF("Bad page state before migrate_pages. Page %d vaddr=%p status %d", i, pages + i * pagesize, status[i]);
-   break;
-   // exit(1);
-   }
-   }*/
-
-  free(addr);
-  free(status);
-  free(nodes);
-  //numa_bitmask_free(node_set);
+void place_all_pages_weighted(MemoryMap &segments,
+                              const std::vector<double> &weights) {
+  place_segments(segments, 1ULL << 20, [&](MemorySegment &segment) {
+    move_pages_weighted(segment, weights);
+  });
+}
 
+std::vector<double> node_weights(void) {
+  return record_weights(nodes_info);
 }
 
 // interleave pages using the weights
 void place_pages_weighted(void *addr, unsigned long len) {
-
-  size_t size = len;
-  void *start = addr;
-  int i;
-  pagesize = numa_pagesize();
-// printf("original size: %zu\n", size);
-
-// nodes that can still receive pages
-  struct bitmask *node_set = numa_bitmask_alloc(MAX_NODES);  // numa_allocate_nodemask();
-  numa_bitmask_setall(node_set);
-
-  float w = 0;  // weight that has already been allocated among the nodes that can still receive pages
-  int a = MAX_NODES;  // number of nodes which can still receive pages
-
-  size_t total_size = 0;  // total size interleaved so far
-  size_t my_size = 0;
-
-  size_t remaining_a;
-
-  for (i = 0; i < MAX_NODES; ++i) {
-    if (total_size == size) {
-      break;
-    }
-
-    // b = size that remains to allocate in the next node with smallest beta
-    float b = nodes_info_temp[i].weight - w;
-    // printf("i: %d\tb: %.2f\ta:%d\n", i, b, a);
-    // if (b != 0) {
-    my_size = a * (b / 100) * size;
-    // printf("my_size_a: %ld\n", my_size);
-
-    // round up to multiple of the page size
-    my_size = PAGE_ALIGN_UP(my_size);
-
-    remaining_a = size - total_size;
-    if (my_size > remaining_a) {
-      my_size = remaining_a;
-    }
-    // printf("my_size_b: %zu\n", my_size);
-    total_size += my_size;
-
-    // only interleave if memory is in the region
-    if (my_size != 0) {
-      // LDEBUGF("mbind(%p, %lu, INTERLEAVE, %lx, %zu, MOVE|STRICT)",
-      //       start, my_size, *(node_set->maskp), node_set->size + 1);
-      DIEIF(
-          WRAP(mbind)(start, my_size, MPOL_INTERLEAVE, node_set->maskp, node_set->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-          "mbind interleave failed");
-    }
-
-    start =
-        reinterpret_cast<void*>(reinterpret_cast<intptr_t>(start) + my_size);  // increment base to a new location
-    a--;  // one less node where to allocate pages
-    w = nodes_info_temp[i].weight;  // we update the size already allocated in the remaining nodes
-    if (numa_bitmask_isbitset(node_set, nodes_info_temp[i].id)) {
-      numa_bitmask_clearbit(node_set, nodes_info_temp[i].id);  // remove node i from the set of remaining nodes
-    }
-  }
-
-  numa_bitmask_free(node_set);
+  bind_plan(addr, PlacementPlan::interleaved(
+      unit_layout(addr, len / numa_pagesize()),
+      record_weights(nodes_info_temp.data())));
 }
 
 //From local to remote weighted page placement respecting dwp
@@ -399,61 +491,36 @@ void place_pages_weighted_dwp(void *addr, unsigned long len, double s) {
     double new_s = 0;
 
     new_s = sum_ww - s;
+    nodes_info_temp.resize(NUM_NODES);
     // Calculate new weights
     printf("NODE Weights: \t");
     double sum = 0;
 
-    for (i = 0; i < MAX_NODES; i++) {
-      switch (OPT_NUM_WORKERS_VALUE) {
-        case 1:
-          // workers: 0
-          if (nodes_info[i].id == 0) {
-            nodes_info_temp[i].id = nodes_info[i].id;
-            nodes_info_temp[i].weight = round(
-                nodes_info[i].weight / sum_ww * new_s);
-            printf("%.2f\t", nodes_info_temp[i].weight);
-            sum += nodes_info_temp[i].weight;
-          } else {
-            nodes_info_temp[i].id = nodes_info[i].id;
-            nodes_info_temp[i].weight = round(100 - new_s);
-            printf("%.2f\t", nodes_info_temp[i].weight);
-            sum += nodes_info_temp[i].weight;
-          }
-          break;
-        case 2:
-          // workers: 1
-          if (nodes_info[i].id == 1) {
-            nodes_info_temp[i].id = nodes_info[i].id;
-            nodes_info_temp[i].weight = round(
-                nodes_info[i].weight / sum_ww * new_s);
-            printf("%.2f\t", nodes_info_temp[i].weight);
-            sum += nodes_info_temp[i].weight;
-          } else {
-            nodes_info_temp[i].id = nodes_info[i].id;
-            nodes_info_temp[i].weight = round(100 - new_s);
-            printf("%.2f\t", nodes_info_temp[i].weight);
-            sum += nodes_info_temp[i].weight;
-          }
-          break;
-        default:
-          LINFOF("Sorry, %d Worker nodes is not supported at the moment!\n",
-                 OPT_NUM_WORKERS_VALUE)
-          ;
-          exit(-1);
+    for (i = 0; i < NUM_NODES; i++) {
+      nodes_info_temp[i].id = nodes_info[i].id;
+      if (is_worker_node(nodes_info[i].id)) {
+        nodes_info_temp[i].weight = nodes_info[i].weight / sum_ww * new_s;
+      } else if (sum_nww > 0) {
+        nodes_info_temp[i].weight = nodes_info[i].weight / sum_nww
+            * (100 - new_s);
+      } else {
+        nodes_info_temp[i].weight = 0;
       }
+      printf("%.2f\t", nodes_info_temp[i].weight);
+      sum += nodes_info_temp[i].weight;
     }
 
     printf("%.2f\n", sum);
 
     printf("NODE IDs: \t");
-    for (i = 0; i < MAX_NODES; i++) {
+    for (i = 0; i < NUM_NODES; i++) {
       printf("%d\t", nodes_info_temp[i].id);
     }
     printf("\n");
 
-    if ((check_sum(nodes_info_temp)) != 100) {
+    if ((check_sum(nodes_info_temp.data())) != 100) {
       printf("**Sum of New weights must be equal to 100, sum=%d!**\n",
-             check_sum(nodes_info_temp));
+             check_sum(nodes_info_temp.data()));
       exit(-1);
     }
 
@@ -475,113 +542,37 @@ void place_pages_weighted_s(void *addr, unsigned long len, double s) {
     double new_s = 0;
 
     new_s = sum_ww + s;
+    nodes_info_temp.resize(NUM_NODES);
     // Calculate new weights
     // printf("NODE Weights: \t");
     double sum = 0;
 
-    for (i = 0; i < MAX_NODES; i++) {
-      switch (OPT_NUM_WORKERS_VALUE) {
-        case 1:
-          // workers: 0
-          if (nodes_info[i].id == 0) {
-            nodes_info_temp[i].id = nodes_info[i].id;
-            nodes_info_temp[i].weight = round(
-                (nodes_info[i].weight / sum_ww * new_s) * 10) / 10;
-            //printf("%.2f\t", nodes_info_temp[i].weight);
-            sum += nodes_info_temp[i].weight;
-          } else {
-            nodes_info_temp[i].id = nodes_info[i].id;
-            nodes_info_temp[i].weight = round(
-                (nodes_info[i].weight / sum_nww * (100 - new_s)) * 10) / 10;
-            //printf("%.2f\t", nodes_info_temp[i].weight);
-            sum += nodes_info_temp[i].weight;
-          }
-          break;
-        case 2:
-          // workers: 1
-          if (nodes_info[i].id == 1) {
-            nodes_info_temp[i].id = nodes_info[i].id;
-            nodes_info_temp[i].weight = round(
-                (nodes_info[i].weight / sum_ww * new_s) * 10) / 10;
-            //printf("%.2f\t", nodes_info_temp[i].weight);
-            sum += nodes_info_temp[i].weight;
-          } else {
-            nodes_info_temp[i].id = nodes_info[i].id;
-            nodes_info_temp[i].weight = round(
-                (nodes_info[i].weight / sum_nww * (100 - new_s)) * 10) / 10;
-            //printf("%.2f\t", nodes_info_temp[i].weight);
-            sum += nodes_info_temp[i].weight;
-          }
-          break;
-          /*case 2:
-           // workers: 0, 1
-           if (nodes_info[i].id == 0 || nodes_info[i].id == 1) {
-           nodes_info_temp[i].id = nodes_info[i].id;
-           nodes_info_temp[i].weight = round(
-           (nodes_info[i].weight / sum_ww * new_s) * 10) / 10;
-           //printf("%.2f\t", nodes_info_temp[i].weight);
-           sum += nodes_info_temp[i].weight;
-           } else {
-           nodes_info_temp[i].id = nodes_info[i].id;
-           nodes_info_temp[i].weight = round(
-           (nodes_info[i].weight / sum_nww * (100 - new_s)) * 10) / 10;
-           //printf("%.2f\t", nodes_info_temp[i].weight);
-           sum += nodes_info_temp[i].weight;
-           }
-           break;
-           case 3:
-           // workers: 1,2,3
-           if (nodes_info[i].id == 1 || nodes_info[i].id == 2
-           || nodes_info[i].id == 3) {
-           nodes_info_temp[i].id = nodes_info[i].id;
-           nodes_info_temp[i].weight = round(
-           (nodes_info[i].weight / sum_ww * new_s) * 10) / 10;
-           //printf("%.2f\t", nodes_info_temp[i].weight);
-           sum += nodes_info_temp[i].weight;
-           } else {
-           nodes_info_temp[i].id = nodes_info[i].id;
-           nodes_info_temp[i].weight = round(
-           (nodes_info[i].weight / sum_nww * (100 - new_s)) * 10) / 10;
-           //printf("%.2f\t", nodes_info_temp[i].weight);
-           sum += nodes_info_temp[i].weight;
-           }
-           break;
-           case 4:
-           // workers: 0,1,2,3
-           if (nodes_info[i].id == 0 || nodes_info[i].id == 1
-           || nodes_info[i].id == 2 || nodes_info[i].id == 3) {
-           nodes_info_temp[i].id = nodes_info[i].id;
-           nodes_info_temp[i].weight = round(
-           (nodes_info[i].weight / sum_ww * new_s) * 10) / 10;
-           //printf("%.2f\t", nodes_info_temp[i].weight);
-           sum += nodes_info_temp[i].weight;
-           } else {
-           nodes_info_temp[i].id = nodes_info[i].id;
-           nodes_info_temp[i].weight = round(
-           (nodes_info[i].weight / sum_nww * (100 - new_s)) * 10) / 10;
-           //printf("%.2f\t", nodes_info_temp[i].weight);
-           sum += nodes_info_temp[i].weight;
-           }
-           break;*/
-        default:
-          LINFOF("Sorry, %d Worker nodes is not supported at the moment!\n",
-                 OPT_NUM_WORKERS_VALUE)
-          ;
-          exit(-1);
+    for (i = 0; i < NUM_NODES; i++) {
+      nodes_info_temp[i].id = nodes_info[i].id;
+      if (is_worker_node(nodes_info[i].id)) {
+        nodes_info_temp[i].weight = round(
+            (nodes_info[i].weight / sum_ww * new_s) * 10) / 10;
+      } else if (sum_nww > 0) {
+        nodes_info_temp[i].weight = round(
+            (nodes_info[i].weight / sum_nww * (100 - new_s)) * 10) / 10;
+      } else {
+        nodes_info_temp[i].weight = 0;
       }
+      //printf("%.2f\t", nodes_info_temp[i].weight);
+      sum += nodes_info_temp[i].weight;
     }
 
     /* printf("%.2f\n", sum);
 
      printf("NODE IDs: \t");
-     for (i = 0; i < MAX_NODES; i++) {
+     for (i = 0; i < NUM_NODES; i++) {
      printf("%d\t", nodes_info_temp[i].id);
      }
      printf("\n");*/
 
-    if ((check_sum(nodes_info_temp)) != 100) {
+    if ((check_sum(nodes_info_temp.data())) != 100) {
       printf("**Sum of New weights must be equal to 100, sum=%d!**\n",
-             check_sum(nodes_info_temp));
+             check_sum(nodes_info_temp.data()));
       exit(-1);
     }
 
@@ -596,7 +587,7 @@ void place_pages_weighted_s(void *addr, unsigned long len, double s) {
 
 void place_pages(void *addr, unsigned long len, double r) {
 // compute the ratios to input to `mbind`
-  double local_ratio = r - (1.0 - r) / (numa_num_configured_nodes() - 1);
+  double local_ratio = r - (1.0 - r) / (numa().configuredNodes() - 1);
   double interleave_ratio = 1.0 - local_ratio;
 
 // compute the lengths of the interleaved and local segments
@@ -631,47 +622,14 @@ void place_pages(void *addr, unsigned long len, double r) {
   if (local_len <= 0)
     return;
 
-// bind the remainder to the local node
-  struct bitmask *node_set = numa_bitmask_alloc(MAX_NODES);  // numa_allocate_nodemask();
-  if (OPT_NUM_WORKERS_VALUE == 1) {
-    //set the worker bitmask
-    numa_bitmask_setbit(node_set, 0);
-    DIEIF(
-        WRAP(mbind)(local_addr, local_len, MPOL_INTERLEAVE, node_set->maskp, node_set->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-        "mbind interleave failed");
-  } else if (OPT_NUM_WORKERS_VALUE == 2) {
-    numa_bitmask_setbit(node_set, 0);
-    numa_bitmask_setbit(node_set, 1);
-    DIEIF(
-        WRAP(mbind)(local_addr, local_len, MPOL_INTERLEAVE, node_set->maskp, node_set->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-        "mbind interleave failed");
-  } else if (OPT_NUM_WORKERS_VALUE == 3) {
-    numa_bitmask_setbit(node_set, 1);
-    numa_bitmask_setbit(node_set, 2);
-    numa_bitmask_setbit(node_set, 3);
-    DIEIF(
-        WRAP(mbind)(local_addr, local_len, MPOL_INTERLEAVE, node_set->maskp, node_set->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-        "mbind interleave failed");
-  } else if (OPT_NUM_WORKERS_VALUE == 4) {
-    numa_bitmask_setbit(node_set, 0);
-    numa_bitmask_setbit(node_set, 1);
-    numa_bitmask_setbit(node_set, 2);
-    numa_bitmask_setbit(node_set, 3);
-    DIEIF(
-        WRAP(mbind)(local_addr, local_len, MPOL_INTERLEAVE, node_set->maskp, node_set->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-        "mbind interleave failed");
-  }
-
-  else {
-    //do nothing!
-  }
-
-  numa_bitmask_free(node_set);
+// bind the remainder to the local (worker) nodes
+  bind_pages(local_addr, local_len, MPOL_INTERLEAVE, WORKER_NODES->maskp,
+             WORKER_NODES->size + 1);
 //unsigned long zero_mask = 0;
 //LTRACEF("mbind(%p, %lu, MPOL_LOCAL, NULL, 0, MPOL_MF_MOVE | MPOL_MF_STRICT)",
 //        local_addr, local_len);
 //DIEIF(
-//    WRAP(mbind)(local_addr, local_len, MPOL_LOCAL, &zero_mask, 8, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
+//    numa().bind(local_addr, local_len, MPOL_LOCAL, &zero_mask, 8, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
 //    "mbind local failed");
 }
 
@@ -682,8 +640,7 @@ void place_pages(MemorySegment &segment, double ratio) {
   //                       segment.pageAlignedLength(), ratio);
   //place_pages_weighted_dwp(segment.pageAlignedStartAddress(),
   //                         segment.pageAlignedLength(), ratio);
-  move_pages_remote(segment.pageAlignedStartAddress(),
-                    segment.pageAlignedLength(), ratio);
+  move_pages_remote(segment, ratio);
 }
 
 //place pages the adaptive way
@@ -692,6 +649,8 @@ void place_pages_adaptive(MemorySegment &segment, double ratio) {
 // segment.print();
   place_pages(segment.pageAlignedStartAddress(), segment.pageAlignedLength(),
               ratio);
+  //mbind moved the pages, forget the last move_pages placement
+  segment.placement(SegmentPlacement());
 }
 
 /*
@@ -720,224 +679,36 @@ void place_pages_weighted_contiguous(const MemorySegment &segment) {
 
 //weighted interleave with a contiguous memory mapping!
 void place_pages_weighted_contiguous(void *addr, unsigned long len) {
-  size_t size = len;
-  void *start = addr;
-  int i;
-  pagesize = numa_pagesize();
-
-// nodes that can still receive pages
-  struct bitmask *node_set_initial = numa_bitmask_alloc(MAX_NODES);  // numa_allocate_nodemask();
-
-  size_t total_size = 0;  // total size interleaved so far
-  size_t my_size = 0;
-
-  size_t remaining_a;
-
-  for (i = 0; i < MAX_NODES; ++i) {
-    if (total_size == size) {
-      break;
-    }
-
-    numa_bitmask_setbit(node_set_initial, nodes_info[i].id);
-
-    my_size = (nodes_info[i].weight / 100) * size;
-
-    // round up to multiple of the page size
-    my_size = PAGE_ALIGN_UP(my_size);
-
-    remaining_a = size - total_size;
-    if (my_size > remaining_a) {
-      my_size = remaining_a;
-    }
-    total_size += my_size;
-
-    // only mbind if memory is in the region
-    if (my_size != 0) {
-      DIEIF(
-          WRAP(mbind)(start, my_size, MPOL_BIND, node_set_initial->maskp, node_set_initial->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-          "mbind interleave failed");
-
-      start = reinterpret_cast<void*>(reinterpret_cast<intptr_t>(start)
-          + my_size);  // increment base to a new location
-    }
-    if (numa_bitmask_isbitset(node_set_initial, nodes_info[i].id)) {
-      numa_bitmask_clearbit(node_set_initial, nodes_info[i].id);  // remove node i from the set of remaining nodes
-    }
-  }
-
-  numa_bitmask_free(node_set_initial);
+  bind_plan(addr, PlacementPlan::contiguous(
+      unit_layout(addr, len / numa_pagesize()), node_weights()));
 }
 
 //initial page placement with weighted interleave
 void move_pages_initial(void *start, unsigned long len) {
-
-  pagesize = numa_pagesize();
-
-  char *pages;
-
-  int i, j, rc;
-
-  void **addr;
-  int *status;
-  int *nodes;
-
-  int page_count = len / pagesize;
-
-  addr = (void **) malloc(sizeof(char *) * page_count);
-  status = (int *) malloc(page_count * sizeof(int *));
-  nodes = (int *) malloc(page_count * sizeof(int *));
-
-  if (!start || !addr || !status || !nodes) {
-    LINFO("Unable to allocate memory");
-    exit(1);
-  }
-
-  pages = (char *) start;
-
-  //uniform distribution memory allocation (using the bwap style format)
-  //first set the page addresses, openmp for faster processing
-//#pragma omp parallel for firstprivate(pages,pagesize)
-  for (i = 0; i < page_count; i++) {
-    addr[i] = pages + i * pagesize;
-    nodes[i] = 0;  //incase the last page is not initialized
-  }
-
-  //set the page distribution using a weighted version
-  double i_p;  //interleaved_pages
-  double w = 0;  // weight that has already been allocated among the nodes that can still receive pages
-  int a = MAX_NODES;  // number of nodes which can still receive pages
-  int i_k = 0;  //lower_bound for the pages
-  int r_pages = 0;  //remaining pages
-  int my_node;  //the node of a page
-
-  //create a vector of node id's
-  std::vector<int> node_ids;
-  for (i = 0; i < MAX_NODES; i++) {
-    node_ids.push_back(nodes_info[i].id);
-  }
-
-  for (i = 0; i < MAX_NODES; i++) {
-
-    double b = nodes_info[i].weight - w;
-    i_p = a * (b / 100) * page_count;
-
-    r_pages = page_count - i_k;
-    if (i_p > r_pages) {
-      i_p = r_pages;
-    }
-
-    if (i_k == page_count) {
-      break;
-    }
-
-    if (i_p != 0) {
-      int upper_bound = i_k + i_p;
-      for (j = i_k; j < upper_bound; j++) {
-        my_node = j % a;
-        nodes[j] = node_ids.at(my_node);
-      }
-    }
-
-    node_ids.erase(node_ids.begin());
-    a--;
-    w = nodes_info[i].weight;
-    i_k += i_p;
-
-  }
-
-  //get_node_mappings(page_count, nodes);
-  rc = move_pages(0, page_count, addr, nodes, status, MPOL_MF_MOVE);
-  if (rc < 0 && errno != ENOENT) {
-    perror("move_pages");
-    exit(1);
-  }
-
-  free(addr);
-  free(status);
-  free(nodes);
+  migrate_plan(start, PlacementPlan::interleaved(
+      unit_layout(start, len / numa_pagesize()), node_weights()));
 }
 
 // interleave pages using the weights - use the initial weights!
 void place_pages_weighted_initial(void *addr, unsigned long len) {
-  size_t size = len;
-  void *start = addr;
-  int i;
-  pagesize = numa_pagesize();
-// printf("original size: %zu\n", size);
-
-// nodes that can still receive pages
-  struct bitmask *node_set_initial = numa_bitmask_alloc(MAX_NODES);  // numa_allocate_nodemask();
-  numa_bitmask_setall(node_set_initial);
-
-  float w = 0;  // weight that has already been allocated among the nodes that can still receive pages
-  int a = MAX_NODES;  // number of nodes which can still receive pages
-
-  size_t total_size = 0;  // total size interleaved so far
-  size_t my_size = 0;
-
-  size_t remaining_a;
-
-  for (i = 0; i < MAX_NODES; ++i) {
-    if (total_size == size) {
-      break;
-    }
-
-    // b = size that remains to allocate in the next node with smallest beta
-    float b = nodes_info[i].weight - w;
-    // printf("i: %d\tb: %.2f\ta:%d\n", i, b, a);
-    // if (b != 0) {
-    my_size = a * (b / 100) * size;
-    // printf("my_size_a: %ld\n", my_size);
-
-    // round up to multiple of the page size
-    my_size = PAGE_ALIGN_UP(my_size);
-
-    remaining_a = size - total_size;
-    if (my_size > remaining_a) {
-      my_size = remaining_a;
-    }
-    // printf("my_size_b: %zu\n", my_size);
-    total_size += my_size;
-
-    // only interleave if memory is in the region
-    if (my_size != 0) {
-      // LDEBUGF("mbind(%p, %lu, INTERLEAVE, %lx, %zu, MOVE|STRICT)",
-      //       start, my_size, *(node_set->maskp), node_set->size + 1);
-      DIEIF(
-          WRAP(mbind)(start, my_size, MPOL_INTERLEAVE, node_set_initial->maskp, node_set_initial->size + 1, MPOL_MF_MOVE | MPOL_MF_STRICT) != 0,
-          "mbind interleave failed");
-    }
-
-    start =
-        reinterpret_cast<void*>(reinterpret_cast<intptr_t>(start) + my_size);  // increment base to a new location
-    a--;  // one less node where to allocate pages
-    w = nodes_info[i].weight;  // we update the size already allocated in the remaining nodes
-    if (numa_bitmask_isbitset(node_set_initial, nodes_info[i].id)) {
-      numa_bitmask_clearbit(node_set_initial, nodes_info[i].id);  // remove node i from the set of remaining nodes
-    }
-  }
-
-  numa_bitmask_free(node_set_initial);
+  bind_plan(addr, PlacementPlan::interleaved(
+      unit_layout(addr, len / numa_pagesize()), node_weights()));
 }
 //end initial page placement functions!
 
 void place_all_pages(MemoryMap &segments, double ratio) {
-  for (auto &segment : segments) {
-    if (segment.length() > 1ULL << 20) {
-      place_pages(segment, ratio);
-    }
-  }
+  place_segments(segments, 1ULL << 20, [ratio](MemorySegment &segment) {
+    place_pages(segment, ratio);
+  });
 //print_node_allocations();
   weight_initialized = 0;
 }
 
 //place pages the adaptive way!
 void place_all_pages_adaptive(MemoryMap &segments, double ratio) {
-  for (auto &segment : segments) {
-    if (segment.length() > 1ULL << 20) {
-      place_pages_adaptive(segment, ratio);
-    }
-  }
+  place_segments(segments, 1ULL << 20, [ratio](MemorySegment &segment) {
+    place_pages_adaptive(segment, ratio);
+  });
 }
 
 void place_all_pages_adaptive(double ratio) {
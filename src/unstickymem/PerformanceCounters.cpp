@@ -5,11 +5,16 @@
 #include <vector>
 #include <algorithm>
 #include <numeric>
+#include <cmath>
+#include <mutex>
+#include <ctime>
 #include "unstickymem/unstickymem.h"
 #include <unstickymem/PerformanceCounters.hpp>
 #include <unstickymem/Logger.hpp>
-
-#include <likwid.h>
+#include <unstickymem/Progress.hpp>
+#include <unstickymem/counters/CounterBackend.hpp>
+#include <unstickymem/counters/StallRateSampler.hpp>
+#include <unstickymem/numa/NumaBackend.hpp>
 
 #include <numa.h>
 #include <numaif.h>
@@ -19,7 +24,6 @@
 
 namespace unstickymem {
 
-static bool initiatialized = false;
 //TODO: Remove this hard-coded file parts!
 static FILE *f = fopen("/home/dgureya/bwap/unstickymem_log.txt", "a");
 static FILE *f_1 = fopen("/home/dgureya/bwap/elapsed_stall_rate_log.txt", "a");
@@ -40,377 +44,174 @@ void unstickymem_log_v1(double sr, std::string mode) {
   fprintf(f_1, "%s: elapsed stall rate\t%1.2lf\n", mode.c_str(), sr);
 }
 
-/*
- * A function that uses the likwid library to measure the stall rates
- * Credits: https://github.com/RRZE-HPC/likwid/blob/master/examples/C-likwidAPI.c
- *
- * On AMD we use the following counters
- * EventSelect 0D1h Dispatch Stalls: The number of processor cycles where the decoder
- * is stalled for any reason (has one or more instructions ready but can't dispatch
- * them due to resource limitations in execution)
- * &
- * EventSelect 076h CPU Clocks not Halted: The number of clocks that the CPU is not in a halted state.
- *
- * On Intel we use the following counters
- * RESOURCE_STALLS: Cycles Allocation is stalled due to Resource Related reason
- * &
- * UNHALTED_CORE_CYCLES:  Count core clock cycles whenever the clock signal on the specific
- * core is running (not halted)
- *
- */
-int err;
-int* cpus;
-int gid;
-CpuInfo_t info;
-static int nnodes;
-static int ncpus_per_node;
-static int ncpus;
-static int active_cpus;
-
-//list of all the events for the different architectures supported
-//char amd_estr[] = "CPU_CLOCKS_UNHALTED:PMC0,DISPATCH_STALLS:PMC1"; //AMD
-//char amd_estr[] = "DISPATCH_STALLS:PMC0";  //AMD DISPATCH_STALL_LDQ_FULL,DISPATCH_STALL_FP_SCHED_Q_FULL
-char const *amd_estr = "DISPATCH_STALLS:PMC0";
-//char amd_estr[] = "DISPATCH_STALL_INSTRUCTION_RETIRED_Q_FULL:PMC0";
-//char intel_estr[] =
-//		"CPU_CLOCK_UNHALTED_THREAD_P:PMC0,RESOURCE_STALLS_ANY:PMC1"; //Intel Broadwell EP
-//char intel_estr[] = "RESOURCE_STALLS_ANY:PMC0";  //Intel Broadwell EP, Intel Core Westmere processor
-char const *intel_estr = "RESOURCE_STALLS_ANY:PMC0";
-//if a specific pmc has been specified override the above variables!
-void check_pmc() {
-  if (PMC_VALUE == 1) {
-    amd_estr = "DISPATCH_STALLS:PMC1";
-    intel_estr = "RESOURCE_STALLS_ANY:PMC1";
+// the counters and the previous readings are shared with the sampler thread
+static std::mutex counters_lock;
+
+// stall counts of the monitored units, summed per node and overall
+struct StallCounts {
+  double total = 0;
+  size_t units = 0;
+  std::vector<double> node_total;
+  std::vector<size_t> node_units;
+};
+
+static StallCounts read_stalls() {
+  std::vector<CounterValue> values;
+  DIEIF(!counters().read(&values) || values.empty(),
+        "Failed to read the performance counters");
+  StallCounts counts;
+  counts.node_total.resize(numa().maxNode() + 1, 0);
+  counts.node_units.resize(numa().maxNode() + 1, 0);
+  for (auto &value : values) {
+    counts.total += value.stalls;
+    counts.units++;
+    // units that are not cpus only count towards the global rate
+    int node = value.cpu < 0 ? -1 : numa().nodeOfCpu(value.cpu);
+    if (node >= 0 && node < static_cast<int>(counts.node_total.size())) {
+      counts.node_total[node] += value.stalls;
+      counts.node_units[node]++;
+    }
   }
+  return counts;
 }
 
-void initialize_likwid() {
-  if (!initiatialized) {
-    check_pmc();
-    //perfmon_setVerbosity(3);
-    //Load the topology module and print some values.
-    err = topology_init();
-    if (err < 0) {
-      LDEBUG("Failed to initialize LIKWID's topology module\n");
-      //return 1;
-      exit(-1);
-    }
-    // CpuInfo_t contains global information like name, CPU family, ...
-    //CpuInfo_t info = get_cpuInfo();
-    info = get_cpuInfo();
-    // CpuTopology_t contains information about the topology of the CPUs.
-    CpuTopology_t topo = get_cpuTopology();
-    // Create affinity domains. Commonly only needed when reading Uncore counters
-    affinity_init();
-
-    LINFOF("Likwid Measuremennts on a %s with %d CPUs\n", info->name,
-           topo->numHWThreads);
-
-    ncpus = topo->numHWThreads;
-    nnodes = numa_num_configured_nodes();
-    ncpus_per_node = ncpus / nnodes;
-
-    //active_cpus = OPT_NUM_WORKERS_VALUE * ncpus_per_node;
-    //OPT_NUM_WORKERS_VALUE=3;
-    active_cpus = 1;
-
-    LINFOF(
-        "| [NODES] - %d: [CPUS] - %d: [CPUS_PER_NODE] - %d: [NUM_WORKERS] - %d: [ACTIVE_CPUS] - %d |\n",
-        nnodes, ncpus, ncpus_per_node, OPT_NUM_WORKERS_VALUE, active_cpus);
-
-    //cpus = (int*) malloc(topo->numHWThreads * sizeof(int));
-    //for now only monitor one CPU
-    cpus = (int*) malloc(active_cpus * sizeof(int));
-
-    if (!cpus)
-      exit(-1);		//return 1;
-
-    //If monitoring core has not been specified, then we assume core Zero as the monitoring core
-    if (MONITORING_CORE) {
-      for (int i = 0; i < active_cpus; i++) {
-        cpus[i] = MONITORING_CORE_VALUE;
-      }
-      LINFOF("Monitoring core has been specified ! MONITORING_CORE_VALUE - %d",
-             MONITORING_CORE_VALUE);
-    } else {
-      for (int i = 0; i < active_cpus; i++) {
-        cpus[i] = topo->threadPool[i].apicId;
-      }
-      LINFOF("Monitoring core has not been specified ! using default core - %d",
-             MONITORING_CORE_VALUE);
-    }
-
-    // Must be called before perfmon_init() but only if you want to use another
-    // access mode as the pre-configured one. For direct access (0) you have to
-    // be root.
-    //accessClient_setaccessmode(0);
-    // Initialize the perfmon module.
-    //err = perfmon_init(topo->numHWThreads, cpus);
-    err = perfmon_init(active_cpus, cpus);
-    if (err < 0) {
-      LDEBUG("Failed to initialize LIKWID's performance monitoring module\n");
-      topology_finalize();
-      //return 1;
-      exit(-1);
-    }
+// stalls per monitored unit and clock cycle between two readings
+static double stall_rate(double stalls, double prev_stalls, size_t units,
+                         uint64_t cycles) {
+  return (stalls - prev_stalls) / units / cycles;
+}
 
-    /*
-     * pick the right event based on the architecture,
-     * currently tested on AMD {amd64_fam15h_interlagos && amd64_fam10h_istanbul}
-     * and INTEL {Intel Broadwell EP}
-     * uses a simple flag to do this, may use the more accurate cpu names or families
-     *
-     */
-    LINFOF("Short name of the CPU: %s\n", info->short_name);
-    LINFOF("Intel flag: %d\n", info->isIntel);
-    LINFOF("CPU family ID: %" PRIu32 "\n", info->family);
-    // Add eventset string to the perfmon module.
-    //Intel CPU's
-    if (info->isIntel == 1) {
-      LINFOF("Setting up events %s for %s\n", intel_estr, info->short_name);
-      gid = perfmon_addEventSet(intel_estr);
-    }
-    //for AMD!
-    else if (info->isIntel == 0) {
-      LINFOF("Setting up events %s for %s\n", amd_estr, info->short_name);
-      gid = perfmon_addEventSet(amd_estr);
-    } else {
-      LINFO("Unsupported Architecture at the moment\n");
-      exit(-1);
-    }
+static Objective objective = Objective::STALLS;
 
-    if (gid < 0) {
-      LDEBUGF(
-          "Failed to add event string %s to LIKWID's performance monitoring module\n",
-          intel_estr);
-      perfmon_finalize();
-      topology_finalize();
-      //return 1;
-      exit(-1);
-    }
+void set_objective(Objective o) {
+  objective = o;
+}
 
-    // Setup the eventset identified by group ID (gid).
-    err = perfmon_setupCounters(gid);
-    if (err < 0) {
-      LDEBUGF(
-          "Failed to setup group %d in LIKWID's performance monitoring module\n",
-          gid);
-      perfmon_finalize();
-      topology_finalize();
-      //return 1;
-      exit(-1);
-    }
+Objective get_objective(void) {
+  return objective;
+}
 
-    // Start all counters in the previously set up event set.
-    err = perfmon_startCounters();
-    if (err < 0) {
-      LDEBUGF("Failed to start counters for group %d for thread %d\n", gid,
-              (-1 * err) - 1);
-      perfmon_finalize();
-      topology_finalize();
-      exit(-1);
-      //return 1;
-    }
-    initiatialized = true;
-    //printf("Setting up Likwid statistics for the first time\n");
-  }
+struct ProgressReading {
+  uint64_t ops = 0;
+  struct timespec time = { 0, 0 };
+};
+
+// minus the operations per second reported since prev, lower is better as
+// with stalls
+static double progress_rate(ProgressReading *prev) {
+  ProgressReading now;
+  now.ops = progress_total();
+  clock_gettime(CLOCK_MONOTONIC, &now.time);
+  double elapsed = (now.time.tv_sec - prev->time.tv_sec)
+      + (now.time.tv_nsec - prev->time.tv_nsec) / 1e9;
+  double ops = now.ops - prev->ops;
+  double rate = elapsed > 0 ? -ops / elapsed : 0;
+  *prev = now;
+  return rate;
+}
 
+void initialize_counters() {
+  counters();
 }
 
 double get_elapsed_stall_rate() {
-  //int i, j;
-  double result = 0.0;
-
-  //static double prev_cycles = 0;
+  std::scoped_lock lock(counters_lock);
   static double elapsed_stalls = 0;
   static uint64_t elapsed_clockcounts = 0;
-
-  // Stop all counters in the previously started event set before doing a read.
-  err = perfmon_stopCounters();
-  if (err < 0) {
-    LDEBUGF("Failed to stop counters for group %d for thread %d\n", gid,
-            (-1 * err) - 1);
-    perfmon_finalize();
-    topology_finalize();
-    //return 1;
-    exit(-1);
-  }
-
-  // Read the result of every thread/CPU for all events in estr.
-  // For now just read/print for the active cores only, actually just one core at the moment!
-  // double cycles = 0;
-  double stalls = 0;
-  //j = 0;
-  // char* ptr = NULL;
-  //Results depending on the architecture!
-  if (info->isIntel == 1) {
-    //ptr = strtok(intel_estr, ",");
-    // ptr = intel_estr;
-  } else if (info->isIntel == 0) {
-    //ptr = strtok(amd_estr, ",");
-    // ptr = amd_estr;
-  } else {
-    LDEBUG(
-        "Error: Something went wrong, can't get the measurements at the moment!\n");
-    exit(-1);
-  }
-
-  //while (ptr != NULL) {
-  //for (i = 0; i < active_cpus; i++) {
-  //result = perfmon_getResult(gid, j, i);
-  //if (j == 0) {
-  //  cycles += result;
-  //} else {
-  //stalls += result;
-  //}
-  //printf("Measurement result for event set %s at CPU %d: %f\n", ptr,
-  //    cpus[i], result);
-  //}
-  //  ptr = strtok(NULL, ",");
-  //  j++;
-  //}
-  if (MONITORING_CORE) {
-    result = perfmon_getResult(gid, 0, 0);
-    stalls += result;
-  } else {
-    result = perfmon_getResult(gid, 0, 0);
-    stalls += result;
+  if (objective == +Objective::PROGRESS) {
+    static ProgressReading elapsed_progress;
+    return progress_rate(&elapsed_progress);
   }
 
+  StallCounts counts = read_stalls();
   uint64_t clock = readtsc();  // read clock
-  //double stall_rate = (stalls - prev_stalls) / (cycles - prev_cycles);
-  stalls = stalls / active_cpus;
-  double stall_rate = ((double) (stalls - elapsed_stalls))
-      / (clock - elapsed_clockcounts);
-
-  //printf("clock: %" PRIu64 " prev_clockcounts: %" PRIu64 " clock - prev_clockcounts: %" PRIu64 "\n", clock, prev_clockcounts, (clock - prev_clockcounts));
-  //printf("stalls: %.0f prev_stalls: %.0f stalls - prev_stalls: %.0f\n",
-  //    stalls, prev_stalls, (stalls - prev_stalls));
-  //printf("stall_rate: %f\n", stall_rate);
-
-  //prev_cycles = cycles;
-  elapsed_stalls = stalls;
-  elapsed_clockcounts = clock;
-
-  err = perfmon_startCounters();
-  if (err < 0) {
-    LDEBUGF("Failed to start counters for group %d for thread %d\n", gid,
-            (-1 * err) - 1);
-    perfmon_finalize();
-    topology_finalize();
-    exit(-1);
-    //return 1;
-  }
+  double rate = stall_rate(counts.total, elapsed_stalls, counts.units,
+                           clock - elapsed_clockcounts);
 
-  return stall_rate;
+  elapsed_stalls = counts.total;
+  elapsed_clockcounts = clock;
+  return rate;
 }
 
-double get_stall_rate_v2() {
-  //int i, j;
-  double result = 0.0;
+// per-node rates of the last get_stall_rate_v2 interval
+static std::vector<double> node_stall_rates;
 
-  //static double prev_cycles = 0;
-  static double prev_stalls = 0;
+double get_stall_rate_v2(std::vector<double> *node_rates) {
+  std::scoped_lock lock(counters_lock);
+  static StallCounts prev;
   static uint64_t prev_clockcounts = 0;
 
-  // Stop all counters in the previously started event set before doing a read.
-  err = perfmon_stopCounters();
-  if (err < 0) {
-    LDEBUGF("Failed to stop counters for group %d for thread %d\n", gid,
-            (-1 * err) - 1);
-    perfmon_finalize();
-    topology_finalize();
-    //return 1;
-    exit(-1);
+  // the application's throughput says nothing about single nodes
+  if (objective == +Objective::PROGRESS) {
+    static ProgressReading prev_progress;
+    node_stall_rates.assign(numa().maxNode() + 1, NAN);
+    if (node_rates != nullptr) {
+      *node_rates = node_stall_rates;
+    }
+    return progress_rate(&prev_progress);
   }
 
-  // Read the result of every thread/CPU for all events in estr.
-  // For now just read/print for the active cores only, actually just one core at the moment!
-  // double cycles = 0;
-  double stalls = 0;
-  //j = 0;
-  // char* ptr = NULL;
-  //Results depending on the architecture!
-  if (info->isIntel == 1) {
-    //ptr = strtok(intel_estr, ",");
-    // ptr = intel_estr;
-  } else if (info->isIntel == 0) {
-    //ptr = strtok(amd_estr, ",");
-    // ptr = amd_estr;
-  } else {
-    LDEBUG(
-        "Error: Something went wrong, can't get the measurements at the moment!\n");
-    exit(-1);
+  StallCounts counts = read_stalls();
+  uint64_t clock = readtsc();  // read clock
+  double rate = stall_rate(counts.total, prev.total, counts.units,
+                           clock - prev_clockcounts);
+
+  node_stall_rates.assign(counts.node_total.size(), NAN);
+  for (size_t node = 0; node < counts.node_total.size(); node++) {
+    if (counts.node_units[node] > 0 && prev.node_total.size() > node) {
+      node_stall_rates[node] = stall_rate(counts.node_total[node],
+                                          prev.node_total[node],
+                                          counts.node_units[node],
+                                          clock - prev_clockcounts);
+    }
   }
 
-  //while (ptr != NULL) {
-  //for (i = 0; i < active_cpus; i++) {
-  //result = perfmon_getResult(gid, j, i);
-  //if (j == 0) {
-  //	cycles += result;
-  //} else {
-  //stalls += result;
-  //}
-  //printf("Measurement result for event set %s at CPU %d: %f\n", ptr,
-  //		cpus[i], result);
-  //}
-  //	ptr = strtok(NULL, ",");
-  //	j++;
-  //}
-  if (MONITORING_CORE) {
-    result = perfmon_getResult(gid, 0, 0);
-    stalls += result;
-  } else {
-    result = perfmon_getResult(gid, 0, 0);
-    stalls += result;
+  if (node_rates != nullptr) {
+    *node_rates = node_stall_rates;
   }
 
-  uint64_t clock = readtsc();  // read clock
-  //double stall_rate = (stalls - prev_stalls) / (cycles - prev_cycles);
-  stalls = stalls / active_cpus;
-  double stall_rate = ((double) (stalls - prev_stalls))
-      / (clock - prev_clockcounts);
-
-  //printf("clock: %" PRIu64 " prev_clockcounts: %" PRIu64 " clock - prev_clockcounts: %" PRIu64 "\n", clock, prev_clockcounts, (clock - prev_clockcounts));
-  //printf("stalls: %.0f prev_stalls: %.0f stalls - prev_stalls: %.0f\n",
-  //		stalls, prev_stalls, (stalls - prev_stalls));
-  //printf("stall_rate: %f\n", stall_rate);
-
-  //prev_cycles = cycles;
-  prev_stalls = stalls;
+  prev = counts;
   prev_clockcounts = clock;
+  return rate;
+}
 
-  err = perfmon_startCounters();
-  if (err < 0) {
-    LDEBUGF("Failed to start counters for group %d for thread %d\n", gid,
-            (-1 * err) - 1);
-    perfmon_finalize();
-    topology_finalize();
-    exit(-1);
-    //return 1;
-  }
+std::vector<double> get_node_stall_rates() {
+  std::scoped_lock lock(counters_lock);
+  return node_stall_rates;
+}
 
-  return stall_rate;
-  //return stalls;
+std::vector<double> get_node_bandwidth() {
+  std::scoped_lock lock(counters_lock);
+  static std::vector<double> prev_bytes;
+  static struct timespec prev_time;
+
+  std::vector<NodeTraffic> traffic;
+  std::vector<double> bytes(numa().maxNode() + 1, NAN);
+  if (objective == +Objective::STALLS && counters().readTraffic(&traffic)) {
+    for (auto &node : traffic) {
+      if (node.node >= 0 && node.node < static_cast<int>(bytes.size())) {
+        bytes[node.node] = node.read_bytes + node.write_bytes;
+      }
+    }
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double elapsed = (now.tv_sec - prev_time.tv_sec)
+      + (now.tv_nsec - prev_time.tv_nsec) / 1e9;
+
+  // the first call only sets the baseline
+  std::vector<double> bandwidth(bytes.size(), NAN);
+  for (size_t node = 0; node < bytes.size() && node < prev_bytes.size();
+      node++) {
+    bandwidth[node] = (bytes[node] - prev_bytes[node]) / elapsed;
+  }
+  prev_bytes = bytes;
+  prev_time = now;
+  return bandwidth;
 }
 
 void stop_all_counters() {
-  err = perfmon_stopCounters();
-  if (err < 0) {
-    LDEBUGF("Failed to stop counters for group %d for thread %d\n", gid,
-            (-1 * err) - 1);
-    perfmon_finalize();
-    topology_finalize();
-    //return 1;
-    exit(-1);
-  }
-  free(cpus);
-  // Uninitialize the perfmon module.
-  perfmon_finalize();
-  affinity_finalize();
-  // Uninitialize the topology module.
-  topology_finalize();
-  LINFO("All counters have been stopped\n");
+  counters().stop();
 }
 
 // checks performance counters and computes stalls per second since last call
@@ -435,12 +236,28 @@ double get_stall_rate() {
   return stall_rate;
 }
 
-// samples stall rate multiple times and filters outliers
-double get_average_stall_rate(size_t num_measurements,
-                              useconds_t usec_between_measurements,
-                              size_t num_outliers_to_filter) {
-  //return 0.0;
+// per-node rates averaged over the last get_stall_stats call
+static std::vector<double> average_node_stall_rates;
+
+StallStats get_stall_stats(size_t num_measurements,
+                           useconds_t usec_between_measurements,
+                           size_t num_outliers_to_filter) {
+  double trim = static_cast<double>(num_outliers_to_filter) / num_measurements;
+
+  // the sampler stops as soon as the estimate is precise enough
+  StallRateSampler &sampler = StallRateSampler::getInstance();
+  if (sampler.enabled()) {
+    size_t min_samples = std::min<size_t>(
+        num_measurements,
+        std::max(2 * num_outliers_to_filter + 1, MIN_SAMPLER_SAMPLES));
+    StallStats stats = sampler.measure(min_samples, num_measurements, trim);
+    average_node_stall_rates = sampler.nodeRates();
+    return stats;
+  }
+
   std::vector<double> measurements(num_measurements);
+  std::vector<double> node_rates;
+  std::vector<double> node_sums;
 
   //throw away a measurement, just because
   //get_stall_rate();
@@ -450,33 +267,35 @@ double get_average_stall_rate(size_t num_measurements,
   // do N measurements, T usec apart
   for (size_t i = 0; i < num_measurements; i++) {
     //measurements[i] = get_stall_rate();
-    measurements[i] = get_stall_rate_v2();
+    measurements[i] = get_stall_rate_v2(&node_rates);
+    node_sums.resize(node_rates.size(), 0);
+    for (size_t node = 0; node < node_rates.size(); node++) {
+      node_sums[node] += node_rates[node];
+    }
     //unstickymem_log(measurements[i], i);
     usleep(usec_between_measurements);
   }
 
-  /*for (auto m : measurements) {
-   std::cout << m << " ";
-   }
-   std::cout << std::endl;*/
-
-  // filter outliers
-  std::sort(measurements.begin(), measurements.end());
-  measurements.erase(measurements.end() - num_outliers_to_filter,
-                     measurements.end());
-  measurements.erase(measurements.begin(),
-                     measurements.begin() + num_outliers_to_filter);
-
-  //for logging individual measurements!
-  /*int i = 0;
-   for (auto m : measurements) {
-   unstickymem_log(i, m);
-   i++;
-   }*/
+  // nodes without monitored cpus stay NaN
+  average_node_stall_rates.clear();
+  for (double sum : node_sums) {
+    average_node_stall_rates.push_back(sum / num_measurements);
+  }
+
+  // the trimmed mean filters the outliers
+  return summarize_stall_rates(measurements, trim, DEFAULT_SAMPLER_EWMA_ALPHA);
+}
+
+// samples stall rate multiple times and filters outliers
+double get_average_stall_rate(size_t num_measurements,
+                              useconds_t usec_between_measurements,
+                              size_t num_outliers_to_filter) {
+  return get_stall_stats(num_measurements, usec_between_measurements,
+                         num_outliers_to_filter).trimmed_mean;
+}
 
-  // return the average
-  double sum = std::accumulate(measurements.begin(), measurements.end(), 0.0);
-  return sum / measurements.size();
+std::vector<double> get_average_node_stall_rates() {
+  return average_node_stall_rates;
 }
 
 #if defined(__unix__) || defined(__linux__)
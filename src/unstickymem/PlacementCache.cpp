@@ -0,0 +1,191 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <numa.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "unstickymem/PlacementCache.hpp"
+#include "unstickymem/unstickymem.h"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+// FNV-1a, stable across runs and builds
+static uint64_t fnv1a(const void *data, size_t size,
+                      uint64_t hash = 0xcbf29ce484222325ULL) {
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static std::string hex(uint64_t value) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016lx", value);
+  return buf;
+}
+
+static std::string cpu_model(void) {
+  std::string model = "unknown";
+  FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+  if (cpuinfo == nullptr) {
+    return model;
+  }
+  char *line = nullptr;
+  size_t line_size = 0;
+  while (getline(&line, &line_size, cpuinfo) > 0) {
+    if (strncmp(line, "model name", 10) == 0) {
+      char *value = strchr(line, ':');
+      if (value != nullptr) {
+        model = value + 1;
+      }
+      break;
+    }
+  }
+  WRAP(free)(line);
+  fclose(cpuinfo);
+  return model;
+}
+
+std::string topology_key(void) {
+  std::string description = cpu_model();
+  // the node ids may have gaps, a dense topology gives the same description
+  std::vector<int> nodes;
+  for (int node = 0; node <= numa().maxNode(); node++) {
+    if (numa().nodeExists(node)) {
+      nodes.push_back(node);
+    }
+  }
+  description += "nodes " + std::to_string(nodes.size()) + "\n";
+  for (int i : nodes) {
+    for (int j : nodes) {
+      description += std::to_string(numa().distance(i, j)) + " ";
+    }
+    description += "\n";
+  }
+  description += "workers";
+  for (int node : nodes) {
+    if (is_worker_node(node)) {
+      description += " " + std::to_string(node);
+    }
+  }
+  return hex(fnv1a(description.data(), description.size()));
+}
+
+std::string workload_key(void) {
+  uint64_t hash = 0;
+  int fd = open("/proc/self/exe", O_RDONLY);
+  struct stat st;
+  if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *exe = WRAP(mmap)(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (exe != MAP_FAILED) {
+      hash = fnv1a(exe, st.st_size);
+      WRAP(munmap)(exe, st.st_size);
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  std::string topology = topology_key();
+  return hex(fnv1a(topology.data(), topology.size(), hash));
+}
+
+// empty if the cache is disabled
+static std::string cache_dir(void) {
+  const char *dir = std::getenv("UNSTICKYMEM_CACHE");
+  if (dir != nullptr) {
+    return strcmp(dir, "off") == 0 ? "" : dir;
+  }
+  const char *xdg = std::getenv("XDG_CACHE_HOME");
+  if (xdg != nullptr && *xdg != '\0') {
+    return std::string(xdg) + "/unstickymem";
+  }
+  const char *home = std::getenv("HOME");
+  if (home != nullptr && *home != '\0') {
+    return std::string(home) + "/.cache/unstickymem";
+  }
+  return "";
+}
+
+bool load_cached_placement(const std::string &key, CachedPlacement *entry) {
+  std::string dir = cache_dir();
+  if (dir.empty()) {
+    return false;
+  }
+  FILE *f = fopen((dir + "/" + key).c_str(), "r");
+  if (f == nullptr) {
+    return false;
+  }
+
+  // "ratio <r>" and "weight <node> <w>" lines
+  *entry = CachedPlacement();
+  char *line = nullptr;
+  size_t line_size = 0;
+  while (getline(&line, &line_size, f) > 0) {
+    double value;
+    int node;
+    if (sscanf(line, "ratio %lf", &value) == 1) {
+      entry->ratio = value;
+    } else if (sscanf(line, "weight %d %lf", &node, &value) == 2 && node >= 0
+        && node <= numa().maxNode()) {
+      entry->weights.resize(numa().maxNode() + 1, 0);
+      entry->weights[node] = value;
+    }
+  }
+  WRAP(free)(line);
+  fclose(f);
+  LDEBUGF("loaded cached placement %s/%s", dir.c_str(), key.c_str());
+  return entry->ratio >= 0 || !entry->weights.empty();
+}
+
+bool store_cached_placement(const std::string &key,
+                            const CachedPlacement &entry) {
+  std::string dir = cache_dir();
+  if (dir.empty()) {
+    return false;
+  }
+  // create the directory and its parents
+  for (size_t slash = dir.find('/', 1); ; slash = dir.find('/', slash + 1)) {
+    std::string path = dir.substr(0, slash);
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+      LWARNF("could not create the cache directory %s: %s", path.c_str(),
+             strerror(errno));
+      return false;
+    }
+    if (slash == std::string::npos) {
+      break;
+    }
+  }
+
+  // concurrent runs may store the same key, rename replaces atomically
+  std::string path = dir + "/" + key;
+  std::string tmp = path + "." + std::to_string(getpid());
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (f == nullptr) {
+    LWARNF("could not write %s: %s", tmp.c_str(), strerror(errno));
+    return false;
+  }
+  if (entry.ratio >= 0) {
+    fprintf(f, "ratio %.6lf\n", entry.ratio);
+  }
+  for (size_t node = 0; node < entry.weights.size(); node++) {
+    fprintf(f, "weight %zu %.6lf\n", node, entry.weights[node]);
+  }
+  bool ok = fclose(f) == 0 && rename(tmp.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    LWARNF("could not store the placement in %s", path.c_str());
+    unlink(tmp.c_str());
+  }
+  return ok;
+}
+
+}  // namespace unstickymem
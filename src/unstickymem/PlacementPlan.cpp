@@ -0,0 +1,282 @@
+#include <stdint.h>
+
+#include <numa.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "unstickymem/PlacementPlan.hpp"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+UnitLayout unit_layout(void *start, size_t page_count, size_t unit_pages) {
+  DIEIF(unit_pages == 0, "placement units must have at least one page");
+  UnitLayout layout;
+  layout.unit = unit_pages;
+  size_t page = reinterpret_cast<uintptr_t>(start) / numa_pagesize();
+  layout.lead = page % layout.unit;
+  layout.pages = page_count;
+  layout.units = (layout.lead + page_count + layout.unit - 1) / layout.unit;
+  return layout;
+}
+
+std::vector<size_t> apportion_units(size_t units,
+                                    const std::vector<double> &weights) {
+  double total = 0;
+  for (double weight : weights) {
+    total += std::max(weight, 0.0);
+  }
+  DIEIF(total <= 0, "at least one node needs a positive weight");
+
+  std::vector<size_t> shares(weights.size(), 0);
+  std::vector<double> remainders(weights.size(), 0);
+  size_t given = 0;
+  for (size_t node = 0; node < weights.size(); node++) {
+    double exact = std::max(weights[node], 0.0) / total * units;
+    shares[node] = std::min<size_t>(std::floor(exact), units - given);
+    remainders[node] = exact - shares[node];
+    given += shares[node];
+  }
+
+  // largest fractional parts first, the heavier node on ties so that the
+  // shares keep the order of the weights
+  std::vector<size_t> order(weights.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (remainders[a] != remainders[b]) {
+      return remainders[a] > remainders[b];
+    }
+    return weights[a] > weights[b];
+  });
+  for (size_t i = 0; given < units; i = (i + 1) % order.size()) {
+    if (weights[order[i]] > 0) {
+      shares[order[i]]++;
+      given++;
+    }
+  }
+  return shares;
+}
+
+void PlacementPlan::add(size_t units, std::vector<int> pattern) {
+  if (units == 0) {
+    return;
+  }
+  // runs of the same node merge
+  if (!_stripes.empty() && pattern.size() == 1
+      && _stripes.back().pattern == pattern) {
+    _stripes.back().units += units;
+    return;
+  }
+  size_t first = _stripes.empty() ? 0 :
+      _stripes.back().first + _stripes.back().units;
+  _stripes.push_back({ first, units, std::move(pattern) });
+}
+
+size_t PlacementPlan::stripeOf(size_t unit) const {
+  auto it = std::upper_bound(_stripes.begin(), _stripes.end(), unit,
+                             [](size_t u, const PlanStripe &stripe) {
+                               return u < stripe.first;
+                             });
+  DIEIF(it == _stripes.begin() || unit >= _layout.units,
+        "unit outside of the placement plan");
+  return std::prev(it) - _stripes.begin();
+}
+
+PlacementPlan PlacementPlan::interleaved(const UnitLayout &layout,
+                                         const std::vector<double> &weights) {
+  PlacementPlan plan;
+  plan._layout = layout;
+  std::vector<size_t> shares = apportion_units(layout.units, weights);
+
+  // the nodes that still get units, by share
+  std::vector<int> order;
+  for (size_t node = 0; node < shares.size(); node++) {
+    if (shares[node] > 0) {
+      order.push_back(node);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return shares[a] < shares[b];
+  });
+
+  // each stripe deals the same number of units to the remaining nodes,
+  // up to the share of the smallest of them
+  size_t dealt = 0;
+  for (size_t k = 0; k < order.size(); k++) {
+    size_t level = shares[order[k]];
+    if (level == dealt) {
+      continue;
+    }
+    std::vector<int> nodes(order.begin() + k, order.end());
+    std::sort(nodes.begin(), nodes.end());
+    size_t units = (level - dealt) * nodes.size();
+    plan.add(units, nodes);
+    dealt = level;
+  }
+  return plan;
+}
+
+PlacementPlan PlacementPlan::contiguous(const UnitLayout &layout,
+                                        const std::vector<double> &weights) {
+  PlacementPlan plan;
+  plan._layout = layout;
+  std::vector<size_t> shares = apportion_units(layout.units, weights);
+  for (size_t node = 0; node < shares.size(); node++) {
+    plan.add(shares[node], { (int) node });
+  }
+  return plan;
+}
+
+// slot j sits at frac(j / golden ratio) in [0, 1), the nodes take their
+// shares of that interval in node id order
+static std::vector<int> golden_pattern(size_t slots,
+                                       const std::vector<double> &weights) {
+  std::vector<size_t> shares = apportion_units(slots, weights);
+  const double inv_phi = (std::sqrt(5.0) - 1) / 2;
+  std::vector<size_t> order(slots);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return std::fmod(a * inv_phi, 1.0) < std::fmod(b * inv_phi, 1.0);
+  });
+  std::vector<int> pattern(slots);
+  size_t slot = 0;
+  for (size_t node = 0; node < shares.size(); node++) {
+    for (size_t i = 0; i < shares[node]; i++) {
+      pattern[order[slot++]] = node;
+    }
+  }
+  return pattern;
+}
+
+PlacementPlan PlacementPlan::spread(const UnitLayout &layout,
+                                    const std::vector<double> &weights) {
+  PlacementPlan plan;
+  plan._layout = layout;
+  // whole periods, then a shorter pattern for the rest
+  size_t period = std::min(layout.units, SPREAD_PERIOD);
+  if (period == 0) {
+    return plan;
+  }
+  size_t whole = layout.units - layout.units % period;
+  plan.add(whole, golden_pattern(period, weights));
+  if (whole < layout.units) {
+    plan.add(layout.units - whole, golden_pattern(layout.units - whole,
+                                                  weights));
+  }
+  return plan;
+}
+
+PlacementPlan PlacementPlan::remoteRatio(const UnitLayout &layout,
+                                         double remote_ratio,
+                                         const std::vector<int> &local_nodes,
+                                         const std::vector<int> &remote_nodes) {
+  DIEIF(local_nodes.empty() || remote_nodes.empty(),
+        "the remote ratio needs local and remote nodes");
+  PlacementPlan plan;
+  plan._layout = layout;
+  size_t units = layout.units;
+
+  double interleaved_ratio = remote_ratio <= 50 ? remote_ratio :
+      100 - remote_ratio;
+  size_t interleaved = std::ceil(interleaved_ratio / 100 * units * 2);
+  interleaved = std::min(interleaved, units);
+  bool rest_is_local = remote_ratio <= 50;
+
+  // unit 2k goes to local node k, unit 2k + 1 to remote node k, both
+  // round-robin: the pattern repeats once both sets have wrapped around
+  size_t cycle = std::lcm(local_nodes.size(), remote_nodes.size());
+  std::vector<int> alternating(2 * cycle);
+  for (size_t j = 0; j < cycle; j++) {
+    alternating[2 * j] = local_nodes[j % local_nodes.size()];
+    alternating[2 * j + 1] = remote_nodes[j % remote_nodes.size()];
+  }
+  plan.add(interleaved, alternating);
+
+  // the rest carries on round-robin where the alternation left that set
+  const std::vector<int> &rest = rest_is_local ? local_nodes : remote_nodes;
+  size_t offset = rest_is_local ? (interleaved + 1) / 2 : interleaved / 2;
+  std::vector<int> round_robin(rest.size());
+  for (size_t k = 0; k < rest.size(); k++) {
+    round_robin[k] = rest[(offset + k) % rest.size()];
+  }
+  plan.add(units - interleaved, round_robin);
+  return plan;
+}
+
+const UnitLayout& PlacementPlan::layout() const {
+  return _layout;
+}
+
+const std::vector<PlanStripe>& PlacementPlan::stripes() const {
+  return _stripes;
+}
+
+int PlacementPlan::nodeOf(size_t unit) const {
+  const PlanStripe &stripe = _stripes[stripeOf(unit)];
+  return stripe.pattern[(unit - stripe.first) % stripe.pattern.size()];
+}
+
+int PlacementPlan::nodeOfPage(size_t page) const {
+  return nodeOf((page + _layout.lead) / _layout.unit);
+}
+
+std::vector<size_t> PlacementPlan::nodeUnits() const {
+  std::vector<size_t> units;
+  for (const PlanStripe &stripe : _stripes) {
+    size_t slots = stripe.pattern.size();
+    for (size_t k = 0; k < slots; k++) {
+      size_t node = stripe.pattern[k];
+      units.resize(std::max(units.size(), node + 1), 0);
+      // the first units % slots slots get one more
+      units[node] += stripe.units / slots + (k < stripe.units % slots);
+    }
+  }
+  return units;
+}
+
+PlanCursor::PlanCursor(const PlacementPlan &plan, size_t page)
+    : _plan(plan),
+      _page(page),
+      _unit(0),
+      _stripe(0),
+      _slot(0) {
+  if (done()) {
+    return;
+  }
+  const UnitLayout &layout = plan.layout();
+  _unit = (page + layout.lead) / layout.unit;
+  auto &stripes = plan.stripes();
+  while (_unit >= stripes[_stripe].first + stripes[_stripe].units) {
+    _stripe++;
+  }
+  _slot = (_unit - stripes[_stripe].first) % stripes[_stripe].pattern.size();
+}
+
+bool PlanCursor::done() const {
+  return _page >= _plan.layout().pages;
+}
+
+int PlanCursor::node() const {
+  return _plan.stripes()[_stripe].pattern[_slot];
+}
+
+void PlanCursor::next() {
+  _page++;
+  const UnitLayout &layout = _plan.layout();
+  if (done() || (_page + layout.lead) % layout.unit != 0) {
+    return;
+  }
+  // first page of the next unit
+  _unit++;
+  const PlanStripe &stripe = _plan.stripes()[_stripe];
+  if (_unit == stripe.first + stripe.units) {
+    _stripe++;
+    _slot = 0;
+  } else if (++_slot == stripe.pattern.size()) {
+    _slot = 0;
+  }
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,48 @@
+#include <cstdint>
+
+#include "unstickymem/unstickymem.h"
+#include "unstickymem/Progress.hpp"
+
+namespace unstickymem {
+
+// one cache line per counter, threads do not share lines
+struct alignas(64) ProgressSlot {
+  uint64_t ops;
+};
+
+// zero-initialized, usable before the library constructor runs
+static ProgressSlot progress_slots[PROGRESS_SLOTS];
+static size_t next_progress_slot = 0;
+static thread_local uint64_t *thread_progress = nullptr;
+
+static uint64_t* thread_progress_counter(void) {
+  if (thread_progress == nullptr) {
+    size_t slot = __atomic_fetch_add(&next_progress_slot, 1,
+                                     __ATOMIC_RELAXED);
+    thread_progress = &progress_slots[slot % PROGRESS_SLOTS].ops;
+  }
+  return thread_progress;
+}
+
+uint64_t progress_total(void) {
+  uint64_t total = 0;
+  for (auto &slot : progress_slots) {
+    total += __atomic_load_n(&slot.ops, __ATOMIC_RELAXED);
+  }
+  return total;
+}
+
+}  // namespace unstickymem
+
+extern "C" {
+
+void unstickymem_report_progress(uint64_t ops) {
+  __atomic_fetch_add(unstickymem::thread_progress_counter(), ops,
+                     __ATOMIC_RELAXED);
+}
+
+uint64_t* unstickymem_progress_counter(void) {
+  return unstickymem::thread_progress_counter();
+}
+
+}  // extern "C"
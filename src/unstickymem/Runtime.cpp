@@ -11,6 +11,14 @@
 #include "unstickymem/mode/Mode.hpp"
 #include "unstickymem/Runtime.hpp"
 #include "unstickymem/Logger.hpp"
+#include "unstickymem/memory/MemoryMap.hpp"
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/counters/CounterBackend.hpp"
+#include "unstickymem/counters/SimulatedBackend.hpp"
+#include "unstickymem/counters/StallRateSampler.hpp"
+#include "unstickymem/migration/MigrationPool.hpp"
+#include "unstickymem/numa/SimulatedNuma.hpp"
+#include "unstickymem/PagePlacement.hpp"
 
 namespace unstickymem {
 
@@ -38,6 +46,24 @@ void Runtime::loadConfiguration() {
   std::ifstream ini_filename("unstickymem.ini");
   bool option_help;
   std::string option_loglevel;
+  size_t option_migration_batch;
+  unsigned int option_migration_workers;
+  double option_migration_cpu_budget;
+  bool option_huge_pages;
+  std::string option_granularity;
+  size_t option_tracking_threshold;
+  bool option_async_placement;
+  bool option_first_touch;
+  std::string option_counter_backend;
+  std::string option_counter_scope;
+  std::string option_counter_event;
+  std::string option_monitor_cpus;
+  bool option_memory_traffic;
+  std::string option_objective;
+  bool option_sampler;
+  useconds_t option_sampler_period;
+  double option_sampler_confidence;
+  double option_sampler_alpha;
 
   // library-level options
   po::options_description lib_options("Library Options");
@@ -52,7 +78,76 @@ void Runtime::loadConfiguration() {
       "Run the algorithm automatically at startup")(
       "UNSTICKYMEM_LOGLEVEL",
       po::value < std::string > (&option_loglevel)->default_value("info"),
-      "Log level (trace, debug, info, warn, error, fatal, off)");
+      "Log level (trace, debug, info, warn, error, fatal, off)")(
+      "UNSTICKYMEM_TRACKING_THRESHOLD",
+      po::value<size_t>(&option_tracking_threshold)->default_value(
+          DEFAULT_TRACKING_THRESHOLD),
+      "Smallest allocation (in bytes) tracked as a memory segment")(
+      "UNSTICKYMEM_ASYNC_PLACEMENT",
+      po::value<bool>(&option_async_placement)->default_value(true),
+      "Place new segments from a background thread")(
+      "UNSTICKYMEM_FIRST_TOUCH_INTERLEAVE",
+      po::value<bool>(&option_first_touch)->default_value(true),
+      "Interleave new segments of threads without a policy of their own "
+      "until they are placed")(
+      "UNSTICKYMEM_MIGRATION_BATCH",
+      po::value<size_t>(&option_migration_batch)->default_value(
+          DEFAULT_MIGRATION_BATCH_PAGES),
+      "How many pages to move with each move_pages call")(
+      "UNSTICKYMEM_COUNTER_BACKEND",
+      po::value<std::string>(&option_counter_backend)->default_value("likwid"),
+      "Where stall counts come from (likwid, perf)")(
+      "UNSTICKYMEM_COUNTER_SCOPE",
+      po::value<std::string>(&option_counter_scope)->default_value("cpu"),
+      "What the counters are attached to (cpu, process, thread)")(
+      "UNSTICKYMEM_COUNTER_EVENT",
+      po::value<std::string>(&option_counter_event)->default_value("auto"),
+      "Raw stall event for the perf backend (e.g. 0x01a2), or auto")(
+      "UNSTICKYMEM_MONITOR_CPUS",
+      po::value<std::string>(&option_monitor_cpus)->default_value("affinity"),
+      "Cpus whose stalls are counted in cpu scope (e.g. 0-15,32), or "
+      "affinity for every cpu the process may run on")(
+      "UNSTICKYMEM_MEMORY_TRAFFIC",
+      po::value<bool>(&option_memory_traffic)->default_value(true),
+      "Count the traffic of each node's memory controllers with the uncore "
+      "counters, when the kernel exports them")(
+      "UNSTICKYMEM_OBJECTIVE",
+      po::value<std::string>(&option_objective)->default_value("stalls"),
+      "What the modes optimize: stalls (minimize the stall rate) or "
+      "progress (maximize the ops/s reported with "
+      "unstickymem_report_progress)")(
+      "UNSTICKYMEM_SAMPLER",
+      po::value<bool>(&option_sampler)->default_value(true),
+      "Sample the stall rate from a background thread and stop measuring "
+      "once the confidence target is reached")(
+      "UNSTICKYMEM_SAMPLER_PERIOD",
+      po::value<useconds_t>(&option_sampler_period)->default_value(
+          DEFAULT_SAMPLER_PERIOD),
+      "Time (in microseconds) between two samples of the sampler")(
+      "UNSTICKYMEM_SAMPLER_CONFIDENCE",
+      po::value<double>(&option_sampler_confidence)->default_value(
+          DEFAULT_SAMPLER_CONFIDENCE),
+      "Target half-width of the 95% confidence interval, relative to the "
+      "mean stall rate")(
+      "UNSTICKYMEM_SAMPLER_EWMA_ALPHA",
+      po::value<double>(&option_sampler_alpha)->default_value(
+          DEFAULT_SAMPLER_EWMA_ALPHA),
+      "Weight of the newest sample in the moving average")(
+      "UNSTICKYMEM_MIGRATION_WORKERS",
+      po::value<unsigned int>(&option_migration_workers)->default_value(
+          DEFAULT_MIGRATION_WORKERS_PER_NODE),
+      "Migration threads pinned to each node (0 migrates inline)")(
+      "UNSTICKYMEM_MIGRATION_CPU_BUDGET",
+      po::value<double>(&option_migration_cpu_budget)->default_value(1.0),
+      "Fraction of time each migration thread may spend moving pages")(
+      "UNSTICKYMEM_HUGE_PAGES",
+      po::value<bool>(&option_huge_pages)->default_value(false),
+      "Advise transparent huge pages for large segments and place them in "
+      "whole huge pages")(
+      "UNSTICKYMEM_PLACEMENT_GRANULARITY",
+      po::value<std::string>(&option_granularity)->default_value("page"),
+      "Stripe size of the weighted placements: page, huge, a number of "
+      "pages, or a size such as 64K or 2M");
 
   // load library options from environment
   po::variables_map lib_env;
@@ -96,11 +191,58 @@ void Runtime::loadConfiguration() {
 
   // set log level
   L->loglevel(option_loglevel);
+
+  // smaller allocations go straight to libc
+  MemoryMap::trackingThreshold(option_tracking_threshold);
+  SegmentEventQueue::getInstance().configure(option_async_placement,
+                                             option_first_touch);
+
+  // performance counters
+  CounterConfig counter_config;
+  DIEIF(!CounterScope::_is_valid_nocase(option_counter_scope.c_str()),
+        "invalid UNSTICKYMEM_COUNTER_SCOPE");
+  counter_config.scope =
+      CounterScope::_from_string_nocase(option_counter_scope.c_str());
+  if (option_counter_event != "auto") {
+    counter_config.raw_event = std::stoull(option_counter_event, nullptr, 0);
+  }
+  if (option_monitor_cpus != "affinity") {
+    counter_config.cpus = parse_cpu_list(option_monitor_cpus);
+    DIEIF(counter_config.cpus.empty(), "invalid UNSTICKYMEM_MONITOR_CPUS");
+  }
+  counter_config.memory_traffic = option_memory_traffic;
+  DIEIF(!Objective::_is_valid_nocase(option_objective.c_str()),
+        "invalid UNSTICKYMEM_OBJECTIVE");
+  set_objective(Objective::_from_string_nocase(option_objective.c_str()));
+  // the simulated machine comes with simulated counters
+  if (lib_env["UNSTICKYMEM_COUNTER_BACKEND"].defaulted()
+      && dynamic_cast<SimulatedNuma*>(&numa()) != nullptr) {
+    option_counter_backend = SimulatedBackend::name();
+  }
+  configure_counters(option_counter_backend, counter_config);
+  StallRateSampler::getInstance().configure(option_sampler,
+                                            option_sampler_period,
+                                            option_sampler_confidence,
+                                            option_sampler_alpha);
+
+  // size of the page migration batches
+  migration_batch_pages(option_migration_batch);
+
+  // migration thread pool
+  MigrationPool::getInstance().configure(option_migration_workers,
+                                         option_migration_cpu_budget);
+
+  // THP-aware placement and stripe size
+  huge_page_placement(option_huge_pages);
+  size_t granularity = parse_granularity(option_granularity);
+  DIEIF(granularity == 0, "invalid UNSTICKYMEM_PLACEMENT_GRANULARITY");
+  placement_granularity(granularity);
 }
 
 void Runtime::printConfiguration() {
   LINFOF("Mode:      %s", _mode_name.c_str());
   LINFOF("Autostart: %s", _autostart ? "enabled" : "disabled");
+  LINFOF("Objective: %s", get_objective()._to_string());
 }
 
 std::shared_ptr<Mode> Runtime::getMode() {
@@ -0,0 +1,37 @@
+#include <algorithm>
+
+#include "unstickymem/counters/ChangeDetector.hpp"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+ChangeDetector::ChangeDetector(double delta, double threshold)
+    : _delta(delta),
+      _threshold(threshold) {
+  DIEIF(delta < 0, "the change detector tolerance cannot be negative");
+  DIEIF(threshold <= 0, "the change detector threshold must be positive");
+}
+
+void ChangeDetector::reset() {
+  _count = 0;
+  _mean = 0;
+  _up = _up_min = 0;
+  _down = _down_max = 0;
+}
+
+bool ChangeDetector::add(double value) {
+  _count++;
+  _mean += (value - _mean) / _count;
+
+  _up += value - _mean - _delta;
+  _up_min = std::min(_up_min, _up);
+  _down += value - _mean + _delta;
+  _down_max = std::max(_down_max, _down);
+  return statistic() > _threshold;
+}
+
+double ChangeDetector::statistic() const {
+  return std::max(_up - _up_min, _down_max - _down);
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,101 @@
+#include <sched.h>
+
+#include <mutex>
+#include <vector>
+
+#include <numa.h>
+
+#include "unstickymem/counters/CounterBackend.hpp"
+#include "unstickymem/unstickymem.h"
+
+namespace unstickymem {
+
+static std::string backend_name = "likwid";
+static CounterConfig backend_config;
+
+std::map<std::string, CounterBackend::Description> & CounterBackend::registry() {
+  static std::map<std::string, CounterBackend::Description> r;
+  return r;
+}
+
+void configure_counters(std::string const & backend, CounterConfig config) {
+  if (CounterBackend::getBackend(backend) == nullptr) {
+    LERRORF("Unknown counter backend '%s'", backend.c_str());
+    CounterBackend::printAvailableBackends();
+    DIE("Please select one of the available counter backends");
+  }
+  backend_name = backend;
+  backend_config = config;
+}
+
+// the cpus the process may run on
+static std::vector<int> affinity_cpus() {
+  std::vector<int> cpus;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  DIEIF(sched_getaffinity(0, sizeof(mask), &mask) < 0,
+        "could not read the cpu affinity");
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &mask)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> parse_cpu_list(std::string const & list) {
+  std::vector<int> cpus;
+  struct bitmask *mask = numa_parse_cpustring_all(list.c_str());
+  if (mask == nullptr) {
+    return cpus;
+  }
+  for (unsigned int cpu = 0; cpu < mask->size; cpu++) {
+    if (numa_bitmask_isbitset(mask, cpu)) {
+      cpus.push_back(cpu);
+    }
+  }
+  numa_bitmask_free(mask);
+  return cpus;
+}
+
+// the configured backend first, then the others
+static std::unique_ptr<CounterBackend> start_backend() {
+  CounterConfig config = backend_config;
+  if (config.cpus.empty()) {
+    // BWAP_CORE keeps the old single monitoring core behaviour
+    if (MONITORING_CORE) {
+      config.cpus.push_back(MONITORING_CORE_VALUE);
+    } else {
+      config.cpus = affinity_cpus();
+    }
+  }
+
+  std::vector<std::string> names { backend_name };
+  for (auto &name : CounterBackend::availableBackends()) {
+    if (name != backend_name) {
+      names.push_back(name);
+    }
+  }
+
+  for (auto &name : names) {
+    std::unique_ptr<CounterBackend> backend = CounterBackend::getBackend(name);
+    if (backend->start(config)) {
+      LINFOF("Counting stalls with the %s backend (%s scope, %zu cpus)",
+             name.c_str(), config.scope._to_string(), config.cpus.size());
+      return backend;
+    }
+    LWARNF("The %s counter backend is not available", name.c_str());
+  }
+  DIE("No performance counters available");
+}
+
+CounterBackend& counters(void) {
+  static std::unique_ptr<CounterBackend> backend;
+  static std::once_flag started;
+  std::call_once(started, [] {
+    backend = start_backend();
+  });
+  return *backend;
+}
+
+}  // namespace unstickymem
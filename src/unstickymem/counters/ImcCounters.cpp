@@ -0,0 +1,194 @@
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <numa.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "unstickymem/counters/ImcCounters.hpp"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+static const char PMU_DIR[] = "/sys/bus/event_source/devices";
+// a CAS command moves one cache line
+static const double CACHE_LINE = 64;
+
+static long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+                            int group_fd, unsigned long flags) {
+  return syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+// first line of a sysfs file, empty if it does not exist
+static std::string read_line(const std::string &path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+// places value into the bits of attr named by a format like "config:0-7"
+static bool set_format_field(const std::string &format, uint64_t value,
+                             struct perf_event_attr *attr) {
+  size_t colon = format.find(':');
+  if (colon == std::string::npos) {
+    return false;
+  }
+  std::string field = format.substr(0, colon);
+  __u64 *config = field == "config" ? &attr->config :
+      field == "config1" ? &attr->config1 :
+      field == "config2" ? &attr->config2 : nullptr;
+  if (config == nullptr) {
+    return false;
+  }
+
+  // the bits of value fill the ranges in order, e.g. "config:0-7,32-35"
+  std::stringstream ranges(format.substr(colon + 1));
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    int low, high;
+    if (sscanf(range.c_str(), "%d-%d", &low, &high) != 2) {
+      high = low = std::atoi(range.c_str());
+    }
+    for (int bit = low; bit <= high; bit++) {
+      *config |= (value & 1) << bit;
+      value >>= 1;
+    }
+  }
+  return true;
+}
+
+ImcCounters::~ImcCounters() {
+  stop();
+}
+
+bool ImcCounters::openEvent(const std::string &pmu, const std::string &event,
+                            bool write) {
+  std::string pmu_path = std::string(PMU_DIR) + "/" + pmu;
+  std::string terms = read_line(pmu_path + "/events/" + event);
+  if (terms.empty()) {
+    return false;
+  }
+
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = std::atoi(read_line(pmu_path + "/type").c_str());
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+      | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  // terms like "event=0x04,umask=0x03", laid out by the pmu's format files
+  std::stringstream list(terms);
+  std::string term;
+  while (std::getline(list, term, ',')) {
+    size_t equals = term.find('=');
+    std::string name = term.substr(0, equals);
+    uint64_t value = equals == std::string::npos ? 1 :
+        std::strtoull(term.c_str() + equals + 1, nullptr, 0);
+    if (!set_format_field(read_line(pmu_path + "/format/" + name), value,
+                          &attr)) {
+      LDEBUGF("cannot encode the term %s of %s/%s", term.c_str(), pmu.c_str(),
+              event.c_str());
+      return false;
+    }
+  }
+
+  // the kernel tells how much a count is worth, in the unit it names
+  double bytes = CACHE_LINE;
+  std::string scale = read_line(pmu_path + "/events/" + event + ".scale");
+  if (!scale.empty()) {
+    std::string unit = read_line(pmu_path + "/events/" + event + ".unit");
+    bytes = std::atof(scale.c_str()) * (unit == "MiB" ? 1 << 20 :
+        unit == "MB" ? 1e6 : 1);
+  }
+
+  // uncore events are counted on one cpu of each socket
+  bool opened = false;
+  for (int cpu : parse_cpu_list(read_line(pmu_path + "/cpumask"))) {
+    int fd = perf_event_open(&attr, -1, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0) {
+      LDEBUGF("perf_event_open(%s/%s, cpu %d): %s", pmu.c_str(),
+              event.c_str(), cpu, strerror(errno));
+      continue;
+    }
+    _counters.push_back({ numa_node_of_cpu(cpu), fd, bytes, write });
+    opened = true;
+  }
+  return opened;
+}
+
+bool ImcCounters::start() {
+  DIR *pmus = opendir(PMU_DIR);
+  if (pmus == nullptr) {
+    return false;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(pmus)) != nullptr) {
+    std::string pmu = entry->d_name;
+    if (pmu.compare(0, 10, "uncore_imc") != 0) {
+      continue;
+    }
+    // server parts count CAS commands, client parts have free running
+    // data counters
+    if (!openEvent(pmu, "cas_count_read", false)) {
+      openEvent(pmu, "data_read", false);
+    }
+    if (!openEvent(pmu, "cas_count_write", true)) {
+      openEvent(pmu, "data_write", true);
+    }
+  }
+  closedir(pmus);
+
+  if (_counters.empty()) {
+    LDEBUG("No memory controller counters available");
+    return false;
+  }
+  LINFOF("Counting the memory controller traffic with %zu uncore counters",
+         _counters.size());
+  return true;
+}
+
+bool ImcCounters::read(std::vector<NodeTraffic> *traffic) {
+  if (_counters.empty()) {
+    return false;
+  }
+  size_t first = traffic->size();
+  for (auto &counter : _counters) {
+    uint64_t data[3];  // value, time enabled, time running
+    if (::read(counter.fd, data, sizeof(data)) != sizeof(data)) {
+      return false;
+    }
+    double count = data[2] == 0 ? 0 :
+        data[0] * (static_cast<double>(data[1]) / data[2]);
+
+    // a node's controllers add up into a single entry
+    NodeTraffic *node = nullptr;
+    for (size_t i = first; i < traffic->size(); i++) {
+      if ((*traffic)[i].node == counter.node) {
+        node = &(*traffic)[i];
+      }
+    }
+    if (node == nullptr) {
+      traffic->push_back({ counter.node, 0, 0 });
+      node = &traffic->back();
+    }
+    (counter.write ? node->write_bytes : node->read_bytes) +=
+        count * counter.bytes;
+  }
+  return true;
+}
+
+void ImcCounters::stop() {
+  for (auto &counter : _counters) {
+    close(counter.fd);
+  }
+  _counters.clear();
+}
+
+}  // namespace unstickymem
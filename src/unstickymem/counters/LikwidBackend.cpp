@@ -0,0 +1,174 @@
+#include <numa.h>
+
+//format specifiers for the intN_t types
+#include <inttypes.h>
+
+#include <likwid.h>
+
+#include "unstickymem/counters/LikwidBackend.hpp"
+#include "unstickymem/unstickymem.h"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+static CounterBackend::Registrar<LikwidBackend> registrar(
+    LikwidBackend::name(), LikwidBackend::description());
+
+/*
+ * A backend that uses the likwid library to measure the stall rates
+ * Credits: https://github.com/RRZE-HPC/likwid/blob/master/examples/C-likwidAPI.c
+ *
+ * On AMD we use the following counters
+ * EventSelect 0D1h Dispatch Stalls: The number of processor cycles where the decoder
+ * is stalled for any reason (has one or more instructions ready but can't dispatch
+ * them due to resource limitations in execution)
+ *
+ * On Intel we use the following counters
+ * RESOURCE_STALLS: Cycles Allocation is stalled due to Resource Related reason
+ */
+
+//list of all the events for the different architectures supported
+//char amd_estr[] = "CPU_CLOCKS_UNHALTED:PMC0,DISPATCH_STALLS:PMC1"; //AMD
+//char amd_estr[] = "DISPATCH_STALLS:PMC0";  //AMD DISPATCH_STALL_LDQ_FULL,DISPATCH_STALL_FP_SCHED_Q_FULL
+static char const *amd_estr = "DISPATCH_STALLS:PMC0";
+//char intel_estr[] =
+//		"CPU_CLOCK_UNHALTED_THREAD_P:PMC0,RESOURCE_STALLS_ANY:PMC1"; //Intel Broadwell EP
+//char intel_estr[] = "RESOURCE_STALLS_ANY:PMC0";  //Intel Broadwell EP, Intel Core Westmere processor
+static char const *intel_estr = "RESOURCE_STALLS_ANY:PMC0";
+
+//if a specific pmc has been specified override the above variables!
+static void check_pmc() {
+  if (PMC_VALUE == 1) {
+    amd_estr = "DISPATCH_STALLS:PMC1";
+    intel_estr = "RESOURCE_STALLS_ANY:PMC1";
+  }
+}
+
+bool LikwidBackend::start(const CounterConfig &config) {
+  check_pmc();
+  if (config.raw_event != 0) {
+    LWARN("LIKWID ignores the raw counter event");
+  }
+  if (config.scope != +CounterScope::CPU) {
+    LWARN("LIKWID only counts per cpu");
+  }
+
+  //Load the topology module and print some values.
+  if (topology_init() < 0) {
+    LDEBUG("Failed to initialize LIKWID's topology module");
+    return false;
+  }
+  // CpuInfo_t contains global information like name, CPU family, ...
+  CpuInfo_t info = get_cpuInfo();
+  // CpuTopology_t contains information about the topology of the CPUs.
+  CpuTopology_t topo = get_cpuTopology();
+  // Create affinity domains. Commonly only needed when reading Uncore counters
+  affinity_init();
+
+  LINFOF("Likwid Measuremennts on a %s with %d CPUs", info->name,
+         topo->numHWThreads);
+
+  _cpus = config.cpus;
+  LINFOF("| [NODES] - %d: [CPUS] - %d: [NUM_WORKERS] - %d: [ACTIVE_CPUS] - %zu |",
+         numa_num_configured_nodes(), topo->numHWThreads,
+         OPT_NUM_WORKERS_VALUE, _cpus.size());
+
+  // Must be called before perfmon_init() but only if you want to use another
+  // access mode as the pre-configured one. For direct access (0) you have to
+  // be root.
+  //accessClient_setaccessmode(0);
+  // Initialize the perfmon module.
+  if (perfmon_init(_cpus.size(), _cpus.data()) < 0) {
+    LDEBUG("Failed to initialize LIKWID's performance monitoring module");
+    affinity_finalize();
+    topology_finalize();
+    return false;
+  }
+
+  /*
+   * pick the right event based on the architecture,
+   * currently tested on AMD {amd64_fam15h_interlagos && amd64_fam10h_istanbul}
+   * and INTEL {Intel Broadwell EP}
+   * uses a simple flag to do this, may use the more accurate cpu names or families
+   *
+   */
+  LINFOF("Short name of the CPU: %s", info->short_name);
+  LINFOF("Intel flag: %d", info->isIntel);
+  LINFOF("CPU family ID: %" PRIu32, info->family);
+  // Add eventset string to the perfmon module.
+  char const *estr = info->isIntel == 1 ? intel_estr : amd_estr;
+  LINFOF("Setting up events %s for %s", estr, info->short_name);
+  _gid = perfmon_addEventSet(estr);
+  if (_gid < 0) {
+    LDEBUGF(
+        "Failed to add event string %s to LIKWID's performance monitoring module",
+        estr);
+    stop();
+    return false;
+  }
+
+  // Setup the eventset identified by group ID (gid).
+  if (perfmon_setupCounters(_gid) < 0) {
+    LDEBUGF(
+        "Failed to setup group %d in LIKWID's performance monitoring module",
+        _gid);
+    stop();
+    return false;
+  }
+
+  // Start all counters in the previously set up event set.
+  int err = perfmon_startCounters();
+  if (err < 0) {
+    LDEBUGF("Failed to start counters for group %d for thread %d", _gid,
+            (-1 * err) - 1);
+    stop();
+    return false;
+  }
+
+  // LIKWID's MBOX groups depend on the microarchitecture, the kernel's
+  // uncore PMUs do not
+  if (config.memory_traffic) {
+    _imc.start();
+  }
+  return true;
+}
+
+bool LikwidBackend::read(std::vector<CounterValue> *values) {
+  // Stop all counters in the previously started event set before doing a read.
+  int err = perfmon_stopCounters();
+  if (err < 0) {
+    LDEBUGF("Failed to stop counters for group %d for thread %d", _gid,
+            (-1 * err) - 1);
+    return false;
+  }
+
+  // Read the result of every monitored CPU for the stall event
+  for (size_t i = 0; i < _cpus.size(); i++) {
+    values->push_back({ _cpus[i], perfmon_getResult(_gid, 0, i) });
+  }
+
+  err = perfmon_startCounters();
+  if (err < 0) {
+    LDEBUGF("Failed to start counters for group %d for thread %d", _gid,
+            (-1 * err) - 1);
+    return false;
+  }
+  return true;
+}
+
+bool LikwidBackend::readTraffic(std::vector<NodeTraffic> *traffic) {
+  return _imc.read(traffic);
+}
+
+void LikwidBackend::stop() {
+  _imc.stop();
+  perfmon_stopCounters();
+  // Uninitialize the perfmon module.
+  perfmon_finalize();
+  affinity_finalize();
+  // Uninitialize the topology module.
+  topology_finalize();
+  LINFO("All counters have been stopped");
+}
+
+}  // namespace unstickymem
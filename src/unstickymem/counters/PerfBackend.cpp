@@ -0,0 +1,248 @@
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "unstickymem/counters/PerfBackend.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+static CounterBackend::Registrar<PerfBackend> registrar(
+    PerfBackend::name(), PerfBackend::description());
+
+// raw stall events, same as the ones we use with LIKWID
+static const uint64_t INTEL_RESOURCE_STALLS_ANY = 0x01a2;
+static const uint64_t AMD_DISPATCH_STALLS = 0xd1;
+
+static long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+                            int group_fd, unsigned long flags) {
+  return syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+// vendor and family of the first cpu in /proc/cpuinfo
+static void cpu_vendor(std::string *vendor, int *family) {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  *family = 0;
+  while (std::getline(cpuinfo, line)) {
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string value = line.substr(colon + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+    if (line.compare(0, 9, "vendor_id") == 0) {
+      *vendor = value;
+    } else if (line.compare(0, 10, "cpu family") == 0) {
+      *family = std::atoi(value.c_str());
+      return;
+    }
+  }
+}
+
+// counter value from user space, only valid on the monitored thread
+static bool rdpmc_read(const struct perf_event_mmap_page *pc,
+                       uint64_t *value) {
+  uint32_t seq;
+  uint64_t count;
+  do {
+    seq = pc->lock;
+    __sync_synchronize();
+    uint32_t index = pc->index;
+    if (!pc->cap_user_rdpmc || index == 0) {
+      return false;
+    }
+    uint32_t lo, hi;
+    __asm __volatile__ ("rdpmc" : "=a"(lo), "=d"(hi) : "c"(index - 1) : );
+    int64_t pmc = lo | (uint64_t) hi << 32;
+    // sign-extend to the width of the counter
+    pmc <<= 64 - pc->pmc_width;
+    pmc >>= 64 - pc->pmc_width;
+    count = pc->offset + pmc;
+    __sync_synchronize();
+  } while (pc->lock != seq);
+  *value = count;
+  return true;
+}
+
+// counter value scaled for the time it was not scheduled
+static bool fd_read(int fd, double *value) {
+  uint64_t data[3];  // value, time enabled, time running
+  if (::read(fd, data, sizeof(data)) != sizeof(data)) {
+    return false;
+  }
+  *value = data[2] == 0 ? 0 : data[0] * (static_cast<double>(data[1]) / data[2]);
+  return true;
+}
+
+PerfBackend::~PerfBackend() {
+  stop();
+}
+
+bool PerfBackend::selectStallEvent(uint64_t raw_event) {
+  memset(&_stalls_attr, 0, sizeof(_stalls_attr));
+  _stalls_attr.size = sizeof(_stalls_attr);
+  _stalls_attr.type = PERF_TYPE_RAW;
+
+  std::string vendor;
+  int family;
+  cpu_vendor(&vendor, &family);
+  if (raw_event != 0) {
+    _stalls_attr.config = raw_event;
+  } else if (vendor == "GenuineIntel") {
+    _stalls_attr.config = INTEL_RESOURCE_STALLS_ANY;
+  } else if (vendor == "AuthenticAMD" && family < 0x17) {
+    _stalls_attr.config = AMD_DISPATCH_STALLS;
+  } else {
+    // let the kernel pick the closest event for this cpu
+    _stalls_attr.type = PERF_TYPE_HARDWARE;
+    _stalls_attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+  }
+  LINFOF("Counting %s stalls with %s event 0x%llx", vendor.c_str(),
+         _stalls_attr.type == PERF_TYPE_RAW ? "raw" : "generic",
+         (unsigned long long) _stalls_attr.config);
+  return true;
+}
+
+bool PerfBackend::openGroup(pid_t pid, int cpu, bool inherit, Group *group) {
+  struct perf_event_attr attr = _stalls_attr;
+  attr.disabled = 1;
+  attr.inherit = inherit;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+      | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  group->cpu = cpu;
+  group->stalls_fd = perf_event_open(&attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+  if (group->stalls_fd < 0) {
+    int err = errno;
+    LDEBUGF("perf_event_open(stalls, pid %d, cpu %d): %s", pid, cpu,
+            strerror(err));
+    errno = err;
+    return false;
+  }
+
+  // cycles are optional, they only go along for the ride
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.disabled = 0;
+  group->cycles_fd = perf_event_open(&attr, pid, cpu, group->stalls_fd,
+                                     PERF_FLAG_FD_CLOEXEC);
+  return true;
+}
+
+bool PerfBackend::start(const CounterConfig &config) {
+  selectStallEvent(config.raw_event);
+
+  bool ok = true;
+  switch (config.scope) {
+    case CounterScope::CPU:
+      for (int cpu : config.cpus) {
+        Group group;
+        ok = ok && openGroup(-1, cpu, false, &group);
+        _groups.push_back(group);
+      }
+      break;
+
+    case CounterScope::PROCESS: {
+      // every thread we have now, and the threads they create later
+      DIR *tasks = opendir("/proc/self/task");
+      if (tasks == nullptr) {
+        return false;
+      }
+      struct dirent *entry;
+      while (ok && (entry = readdir(tasks)) != nullptr) {
+        if (entry->d_name[0] == '.') {
+          continue;
+        }
+        Group group;
+        ok = openGroup(std::atoi(entry->d_name), -1, true, &group);
+        _groups.push_back(group);
+      }
+      closedir(tasks);
+      break;
+    }
+
+    case CounterScope::THREAD: {
+      _owner = syscall(SYS_gettid);
+      Group group;
+      ok = openGroup(0, -1, false, &group);
+      if (ok) {
+        // user-space reads through the mmap'd page when rdpmc is allowed
+        void *page = WRAP(mmap)(nullptr, sysconf(_SC_PAGESIZE), PROT_READ,
+                                MAP_SHARED, group.stalls_fd, 0);
+        if (page != MAP_FAILED) {
+          group.page = reinterpret_cast<struct perf_event_mmap_page*>(page);
+        }
+      }
+      _groups.push_back(group);
+      break;
+    }
+  }
+
+  if (!ok || _groups.empty()) {
+    bool denied = errno == EACCES || errno == EPERM;
+    stop();
+    // system-wide counting is privileged, count our own threads instead
+    if (denied && config.scope == +CounterScope::CPU) {
+      LWARN("Not allowed to count per cpu, counting the process threads");
+      CounterConfig process = config;
+      process.scope = CounterScope::PROCESS;
+      return start(process);
+    }
+    return false;
+  }
+  for (auto &group : _groups) {
+    ioctl(group.stalls_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group.stalls_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+  if (config.memory_traffic) {
+    _imc.start();
+  }
+  return true;
+}
+
+bool PerfBackend::read(std::vector<CounterValue> *values) {
+  for (auto &group : _groups) {
+    uint64_t count;
+    double stalls;
+    bool self = syscall(SYS_gettid) == _owner;
+    if (self && group.page != nullptr && rdpmc_read(group.page, &count)) {
+      stalls = count;
+    } else if (!fd_read(group.stalls_fd, &stalls)) {
+      return false;
+    }
+    values->push_back({ group.cpu, stalls });
+  }
+  return true;
+}
+
+bool PerfBackend::readTraffic(std::vector<NodeTraffic> *traffic) {
+  return _imc.read(traffic);
+}
+
+void PerfBackend::stop() {
+  _imc.stop();
+  for (auto &group : _groups) {
+    if (group.page != nullptr) {
+      WRAP(munmap)(group.page, sysconf(_SC_PAGESIZE));
+    }
+    if (group.cycles_fd >= 0) {
+      close(group.cycles_fd);
+    }
+    if (group.stalls_fd >= 0) {
+      close(group.stalls_fd);
+    }
+  }
+  _groups.clear();
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,60 @@
+#include <x86intrin.h>
+
+#include "unstickymem/counters/SimulatedBackend.hpp"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+static CounterBackend::Registrar<SimulatedBackend> registrar(
+    SimulatedBackend::name(), SimulatedBackend::description());
+
+bool SimulatedBackend::start(const CounterConfig &config) {
+  _numa = dynamic_cast<SimulatedNuma*>(&numa());
+  if (_numa == nullptr) {
+    LDEBUG("The simulated counters need UNSTICKYMEM_NUMA=sim");
+    return false;
+  }
+  _stalls = 0;
+  _bytes.assign(_numa->configuredNodes(), 0);
+  _clock = __rdtsc();
+  clock_gettime(CLOCK_MONOTONIC, &_time);
+  return true;
+}
+
+void SimulatedBackend::advance() {
+  // the stall rate is per cycle of the time stamp counter
+  uint64_t clock = __rdtsc();
+  _stalls += _numa->stallRate() * (clock - _clock);
+  _clock = clock;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double seconds = (now.tv_sec - _time.tv_sec)
+      + (now.tv_nsec - _time.tv_nsec) / 1e9;
+  std::vector<double> traffic = _numa->modelTraffic(_numa->pageShares());
+  for (size_t node = 0; node < _bytes.size(); node++) {
+    _bytes[node] += traffic[node] * seconds;
+  }
+  _time = now;
+}
+
+bool SimulatedBackend::read(std::vector<CounterValue> *values) {
+  advance();
+  values->push_back({ -1, _stalls });
+  return true;
+}
+
+bool SimulatedBackend::readTraffic(std::vector<NodeTraffic> *traffic) {
+  advance();
+  for (size_t node = 0; node < _bytes.size(); node++) {
+    // the workload only reads
+    traffic->push_back({ static_cast<int>(node), _bytes[node], 0 });
+  }
+  return true;
+}
+
+void SimulatedBackend::stop() {
+  _numa = nullptr;
+}
+
+}  // namespace unstickymem
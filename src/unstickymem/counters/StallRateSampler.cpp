@@ -0,0 +1,284 @@
+#include <sys/mman.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <boost/math/distributions/students_t.hpp>
+
+#include "unstickymem/counters/StallRateSampler.hpp"
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+double StallStats::confidence() const {
+  // normal approximation, good enough past MIN_SAMPLER_SAMPLES
+  return count < 2 ? INFINITY : 1.96 * std::sqrt(variance / count);
+}
+
+// fills in the median and trimmed mean of the rates
+static void order_statistics(std::vector<double> rates, double trim,
+                             StallStats *stats) {
+  std::sort(rates.begin(), rates.end());
+  size_t n = rates.size();
+  stats->median = n % 2 ? rates[n / 2] : (rates[n / 2 - 1] + rates[n / 2]) / 2;
+  size_t cut = std::min(static_cast<size_t>(trim * n), (n - 1) / 2);
+  double sum = 0;
+  for (size_t i = cut; i < n - cut; i++) {
+    sum += rates[i];
+  }
+  stats->trimmed_mean = sum / (n - 2 * cut);
+}
+
+StallStats summarize_stall_rates(const std::vector<double> &rates,
+                                 double trim, double alpha) {
+  StallStats stats;
+  double m2 = 0;
+  for (double rate : rates) {
+    stats.count++;
+    double delta = rate - stats.mean;
+    stats.mean += delta / stats.count;
+    m2 += delta * (rate - stats.mean);
+    stats.ewma = stats.count == 1 ? rate : alpha * rate
+        + (1 - alpha) * stats.ewma;
+    stats.last = rate;
+  }
+  if (stats.count == 0) {
+    return stats;
+  }
+  stats.variance = stats.count > 1 ? m2 / (stats.count - 1) : 0;
+  order_statistics(rates, trim, &stats);
+  return stats;
+}
+
+StallComparison compare_stall_rates(const StallStats &a, const StallStats &b,
+                                    double significance) {
+  if (a.count < 2 || b.count < 2) {
+    return StallComparison::UNDECIDED;
+  }
+  double va = a.variance / a.count;
+  double vb = b.variance / b.count;
+  double difference = a.mean - b.mean;
+  // noiseless counters, e.g. when nothing runs
+  if (va + vb == 0) {
+    return difference < 0 ? StallComparison::LOWER :
+        difference > 0 ? StallComparison::HIGHER : StallComparison::UNDECIDED;
+  }
+
+  // Welch-Satterthwaite degrees of freedom
+  double t = difference / std::sqrt(va + vb);
+  double df = (va + vb) * (va + vb)
+      / (va * va / (a.count - 1) + vb * vb / (b.count - 1));
+  boost::math::students_t distribution(df);
+  double critical = boost::math::quantile(distribution, 1 - significance / 2);
+  if (std::fabs(t) < critical) {
+    return StallComparison::UNDECIDED;
+  }
+  return t < 0 ? StallComparison::LOWER : StallComparison::HIGHER;
+}
+
+StallRateSampler& StallRateSampler::getInstance(void) {
+  static StallRateSampler *object = nullptr;
+  if (!object) {
+    void *buf = WRAP(mmap)(nullptr, sizeof(StallRateSampler),
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    DIEIF(buf == MAP_FAILED, "error allocating space for stall rate sampler");
+    object = new (buf) StallRateSampler();
+  }
+  return *object;
+}
+
+void StallRateSampler::configure(bool enabled, useconds_t period,
+                                 double confidence, double alpha) {
+  DIEIF(period == 0, "the sampler period must be positive");
+  DIEIF(confidence <= 0, "the sampler confidence target must be positive");
+  DIEIF(alpha <= 0 || alpha > 1, "the sampler EWMA weight must be in ]0, 1]");
+  _enabled = enabled;
+  _period = period;
+  _confidence = confidence;
+  _alpha = alpha;
+}
+
+bool StallRateSampler::enabled() const {
+  return _enabled;
+}
+
+void StallRateSampler::start() {
+  std::call_once(_started, [this] {
+    std::thread sampler(&StallRateSampler::samplerThread, this);
+    sampler.detach();
+    LDEBUGF("started the stall rate sampler (every %u us)", _period);
+  });
+}
+
+void StallRateSampler::samplerThread() {
+  struct timespec origin, now;
+  clock_gettime(CLOCK_MONOTONIC, &origin);
+
+  // the first reading only sets the baseline
+  get_stall_rate_v2();
+  std::vector<double> node_rates;
+  while (true) {
+    usleep(_period);
+    double rate = get_stall_rate_v2(&node_rates);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double time = (now.tv_sec - origin.tv_sec)
+        + (now.tv_nsec - origin.tv_nsec) / 1e9;
+    if (std::isfinite(rate)) {
+      addSample(time, rate, node_rates);
+    }
+  }
+}
+
+void StallRateSampler::addSample(double time, double rate,
+                                 const std::vector<double> &node_rates) {
+  {
+    std::scoped_lock lock(_lock);
+    // the sample in flight during a reset mixes both windows
+    if (_discard_next) {
+      _discard_next = false;
+      return;
+    }
+    _ring[_total % CAPACITY] = { time, rate };
+    _total++;
+
+    // Welford's update of the mean and variance
+    size_t n = _total - _window_start;
+    double delta = rate - _mean;
+    _mean += delta / n;
+    _m2 += delta * (rate - _mean);
+    _ewma = n == 1 ? rate : _alpha * rate + (1 - _alpha) * _ewma;
+
+    _node_sums.resize(node_rates.size(), 0);
+    _node_counts.resize(node_rates.size(), 0);
+    for (size_t node = 0; node < node_rates.size(); node++) {
+      if (!std::isnan(node_rates[node])) {
+        _node_sums[node] += node_rates[node];
+        _node_counts[node]++;
+      }
+    }
+  }
+  _sampled.notify_all();
+}
+
+void StallRateSampler::reset() {
+  start();
+  std::scoped_lock lock(_lock);
+  _window_start = _total;
+  _discard_next = true;
+  _ewma = 0;
+  _mean = 0;
+  _m2 = 0;
+  std::fill(_node_sums.begin(), _node_sums.end(), 0);
+  std::fill(_node_counts.begin(), _node_counts.end(), 0);
+}
+
+size_t StallRateSampler::windowSize() const {
+  // windows longer than the ring only keep their latest samples around
+  return std::min(_total - _window_start, CAPACITY);
+}
+
+StallStats StallRateSampler::computeStats(double trim) const {
+  StallStats stats;
+  stats.count = _total - _window_start;
+  if (stats.count == 0) {
+    return stats;
+  }
+  stats.last = _ring[(_total - 1) % CAPACITY].rate;
+  stats.ewma = _ewma;
+  stats.mean = _mean;
+  stats.variance = stats.count > 1 ? _m2 / (stats.count - 1) : 0;
+
+  // the order statistics come from the samples still in the ring
+  std::vector<double> rates;
+  for (size_t i = _total - windowSize(); i < _total; i++) {
+    rates.push_back(_ring[i % CAPACITY].rate);
+  }
+  order_statistics(rates, trim, &stats);
+  return stats;
+}
+
+StallStats StallRateSampler::stats(double trim) {
+  start();
+  std::scoped_lock lock(_lock);
+  return computeStats(trim);
+}
+
+StallStats StallRateSampler::measure(size_t min_samples, size_t max_samples,
+                                     double trim) {
+  reset();
+  max_samples = std::max(min_samples, max_samples);
+  std::unique_lock<std::mutex> lock(_lock);
+  StallStats result;
+  _sampled.wait(lock, [&] {
+    result = computeStats(trim);
+    return result.count >= max_samples
+        || (result.count >= min_samples
+            && result.confidence() <= _confidence * std::fabs(result.mean));
+  });
+  LDEBUGF("measured %1.10lf +- %1.10lf with %zu samples", result.mean,
+          result.confidence(), result.count);
+  return result;
+}
+
+StallStats StallRateSampler::extend(size_t count, double trim) {
+  start();
+  std::unique_lock<std::mutex> lock(_lock);
+  StallStats result;
+  _sampled.wait(lock, [&] {
+    result = computeStats(trim);
+    return result.count >= count;
+  });
+  return result;
+}
+
+StallComparison StallRateSampler::compare(StallStats *current,
+                                          const StallStats &other,
+                                          double significance,
+                                          size_t max_samples, double trim) {
+  StallComparison verdict = compare_stall_rates(*current, other,
+                                                significance);
+  while (verdict == StallComparison::UNDECIDED && _enabled
+      && current->count < max_samples) {
+    *current = extend(
+        std::min(current->count + MIN_SAMPLER_SAMPLES, max_samples), trim);
+    verdict = compare_stall_rates(*current, other, significance);
+  }
+  return verdict;
+}
+
+StallComparison StallRateSampler::compare(StallStats *current,
+                                          const StallStats &other,
+                                          double significance,
+                                          size_t max_samples,
+                                          unsigned int num_polls,
+                                          unsigned int num_outliers) {
+  double trim = static_cast<double>(num_outliers) / num_polls;
+  return compare(current, other, significance, max_samples, trim);
+}
+
+std::vector<double> StallRateSampler::nodeRates() {
+  std::scoped_lock lock(_lock);
+  std::vector<double> rates;
+  for (size_t node = 0; node < _node_sums.size(); node++) {
+    rates.push_back(_node_counts[node] > 0 ?
+        _node_sums[node] / _node_counts[node] : NAN);
+  }
+  return rates;
+}
+
+std::vector<StallSample> StallRateSampler::history(size_t count) {
+  std::scoped_lock lock(_lock);
+  count = std::min({ count, _total, CAPACITY });
+  std::vector<StallSample> samples;
+  for (size_t i = _total - count; i < _total; i++) {
+    samples.push_back(_ring[i % CAPACITY]);
+  }
+  return samples;
+}
+
+}  // namespace unstickymem
@@ -7,6 +7,8 @@
 #include "unstickymem/Runtime.hpp"
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/Logger.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
+#include "unstickymem/PagePlacement.hpp"
 #include "unstickymem/wrap.hpp"
 
 extern void *etext;
@@ -15,13 +17,15 @@ extern void *end;
 
 namespace unstickymem {
 
+size_t MemoryMap::_tracking_threshold = DEFAULT_TRACKING_THRESHOLD;
+
 MemoryMap::MemoryMap() {
   // create independent segment to store the MemoryMap
   LFATAL("going to create segment");
   /*Manager *segment_manager = _segment.get_segment_manager();
   _segments = _segment.construct < SegmentsList
       > ("unstickymem")(segment_manager);*/
-  _segments = new std::list<MemorySegment>();
+  _segments = new SegmentsTree();
 
   // open maps file
   FILE *maps = fopen("/proc/self/maps", "r");
@@ -34,26 +38,24 @@ MemoryMap::MemoryMap() {
     MemorySegment s(line);
     if (s.name() == "[heap]") {
       // found the heap!
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "heap");
-      _heap = &_segments->back();
-      Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+      _heap = &addSegment(s.startAddress(), s.endAddress(), "heap");
+      _heap_end = reinterpret_cast<uintptr_t>(s.endAddress());
+      Runtime::getInstance().getMode()->processSegmentAddition(*_heap);
     } else if (s.name() == "[stack]") {
       // found the stack!
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "stack");
-      _stack = &_segments->back();
+      _stack = &addSegment(s.startAddress(), s.endAddress(), "stack");
     } else if (s.contains(&etext - 1)) {
       // found the text segment (read-only data)
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "text");
-      _text = &_segments->back();
-      Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+      _text = &addSegment(s.startAddress(), s.endAddress(), "text");
+      Runtime::getInstance().getMode()->processSegmentAddition(*_text);
     } else if (s.contains(&edata - 1)) {
       // found the data segment (global variables)
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "data");
-      _data = &_segments->back();
-      Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+      _data = &addSegment(s.startAddress(), s.endAddress(), "data");
+      Runtime::getInstance().getMode()->processSegmentAddition(*_data);
     } else if (s.name() == "") {
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "anonymous");
-      Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+      MemorySegment &segment = addSegment(s.startAddress(), s.endAddress(),
+                                          "anonymous");
+      Runtime::getInstance().getMode()->processSegmentAddition(segment);
     }
   }
 
@@ -82,34 +84,190 @@ MemoryMap& MemoryMap::getInstance(void) {
 }
 
 void MemoryMap::print(void) const {
-  for (auto &segment : *_segments) {
-    segment.print();
+  std::scoped_lock lock(_segments_lock);
+  for (const auto &entry : *_segments) {
+    entry.second.print();
+  }
+}
+
+SegmentsTree::iterator MemoryMap::findSegment(void *addr) {
+  // the only candidate is the last segment starting at or before addr
+  auto it = _segments->upper_bound(reinterpret_cast<uintptr_t>(addr));
+  if (it == _segments->begin()) {
+    return _segments->end();
+  }
+  --it;
+  return it->second.contains(addr) ? it : _segments->end();
+}
+
+MemorySegment& MemoryMap::addSegment(void *start, void *end,
+                                     std::string name) {
+  // anything still indexed in this range was unmapped behind our back
+  MemorySegment segment(start, end, name);
+  auto it = _segments->upper_bound(reinterpret_cast<uintptr_t>(end));
+  while (it != _segments->begin()) {
+    auto prev = std::prev(it);
+    if (!prev->second.intersectsWith(segment)) {
+      break;
+    }
+    MemorySegment *old = &prev->second;
+    if (old == _heap || old == _stack || old == _text || old == _data) {
+      LWARNF("segment [%p:%p] overlaps the %s", start, end,
+             old->name().c_str());
+      break;
+    }
+    removeSegment(prev);
+  }
+  return _segments->emplace(reinterpret_cast<uintptr_t>(start),
+                            segment).first->second;
+}
+
+void MemoryMap::removeSegment(SegmentsTree::iterator it) {
+  Runtime::getInstance().getMode()->processSegmentRemoval(it->second);
+  _segments->erase(it);
+}
+
+void MemoryMap::trackSegment(void *start, void *end, std::string name) {
+  MemorySegment segment(start, end, name);
+  {
+    std::scoped_lock lock(_segments_lock);
+    segment = addSegment(start, end, name);
+  }
+  segmentAdded(segment);
+}
+
+void MemoryMap::segmentAdded(const MemorySegment &segment) {
+  // before the application touches it, so that it faults in huge pages
+  advise_huge_pages(segment);
+  // the placement thread takes over unless the event cannot be queued
+  SegmentEvent event { segment.startAddress(), segment.endAddress() };
+  if (!SegmentEventQueue::getInstance().push(event)) {
+    Runtime::getInstance().getMode()->processSegmentAddition(segment);
+  }
+}
+
+void MemoryMap::processSegmentEvent(const SegmentEvent &event) {
+  // the segment may have been freed or replaced in the meantime
+  MemorySegment segment(event.start, event.end, "");
+  if (!copySegment(event.start, &segment)
+      || segment.endAddress() != event.end) {
+    return;
+  }
+  // placed without the lock, the placement skips the pages of a segment
+  // that is unmapped under it
+  Runtime::getInstance().getMode()->processSegmentAddition(segment);
+}
+
+std::vector<void*> MemoryMap::largestSegments(size_t count,
+                                             size_t min_length) {
+  updateHeap();
+  std::scoped_lock lock(_segments_lock);
+  std::vector<MemorySegment*> candidates;
+  for (auto &entry : *_segments) {
+    if (entry.second.length() > min_length) {
+      candidates.push_back(&entry.second);
+    }
+  }
+  count = std::min(count, candidates.size());
+  std::partial_sort(candidates.begin(), candidates.begin() + count,
+                    candidates.end(),
+                    [](MemorySegment *a, MemorySegment *b) {
+                      return a->length() > b->length();
+                    });
+  std::vector<void*> starts;
+  for (size_t i = 0; i < count; i++) {
+    starts.push_back(candidates[i]->startAddress());
+  }
+  return starts;
+}
+
+bool MemoryMap::copySegment(void *start, MemorySegment *segment) {
+  std::scoped_lock lock(_segments_lock);
+  auto it = findSegment(start);
+  if (it == _segments->end() || it->second.startAddress() != start) {
+    return false;
+  }
+  *segment = it->second;
+  return true;
+}
+
+bool MemoryMap::updateSegment(const MemorySegment &segment) {
+  std::vector<MemorySegment> replaced;
+  {
+    std::scoped_lock lock(_segments_lock);
+    auto it = findSegment(segment.startAddress());
+    if (it != _segments->end()
+        && it->second.startAddress() == segment.startAddress()
+        && (it->second.endAddress() == segment.endAddress()
+            || &it->second == _heap)) {
+      // the heap follows the break but is never replaced
+      it->second.placement(segment.placement());
+      it->second.tuning(segment.tuning());
+      return true;
+    }
+
+    // the segment was freed or resized while its pages moved, the segments
+    // now in its range forget where their pages are
+    it = _segments->upper_bound(
+        reinterpret_cast<uintptr_t>(segment.endAddress()));
+    while (it != _segments->begin()) {
+      --it;
+      if (!it->second.intersectsWith(segment)) {
+        break;
+      }
+      it->second.placement(SegmentPlacement());
+      it->second.tuning(SegmentTuning());
+      replaced.push_back(it->second);
+    }
+  }
+  // and get the mode's placement for new segments again
+  LDEBUGF("segment [%p:%p] changed while its pages moved, %zu replaced it",
+          segment.startAddress(), segment.endAddress(), replaced.size());
+  for (const MemorySegment &s : replaced) {
+    Runtime::getInstance().getMode()->processSegmentAddition(s);
+  }
+  return false;
+}
+
+void MemoryMap::removeSegment(void *addr) {
+  auto it = findSegment(addr);
+  if (it != _segments->end()) {
+    removeSegment(it);
   }
 }
 
 void MemoryMap::updateHeap(void) {
   void *addr = WRAP(sbrk)(0);
+  _heap_end.store(reinterpret_cast<uintptr_t>(addr));
+  std::scoped_lock lock(_segments_lock);
   if (_heap->endAddress() != addr) {
-    _heap->endAddress(WRAP(sbrk)(0));
+    _heap->endAddress(addr);
     //Runtime::getInstance().getMode()->processSegmentAddition(*_heap);
   }
 }
 
-// iterators
-SegmentsList::iterator MemoryMap::begin() noexcept {
-  return _segments->begin();
-}
-
-SegmentsList::iterator MemoryMap::end() noexcept {
-  return _segments->end();
+bool MemoryMap::inHeap(void *addr) {
+  // the heap start never moves, and the break only has to be read again for
+  // addresses past the cached one, where the heap may have grown to. a heap
+  // that shrank is noticed by the next updateHeap
+  uintptr_t address = reinterpret_cast<uintptr_t>(addr);
+  if (address < reinterpret_cast<uintptr_t>(_heap->startAddress())) {
+    return false;
+  }
+  uintptr_t cached = _heap_end.load(std::memory_order_relaxed);
+  if (address >= cached) {
+    cached = reinterpret_cast<uintptr_t>(WRAP(sbrk)(0));
+    _heap_end.store(cached, std::memory_order_relaxed);
+  }
+  return address < cached;
 }
 
-SegmentsList::const_iterator MemoryMap::cbegin() const noexcept {
-  return _segments->cbegin();
+void MemoryMap::trackingThreshold(size_t size) {
+  _tracking_threshold = size;
 }
 
-SegmentsList::const_iterator MemoryMap::cend() const noexcept {
-  return _segments->cend();
+size_t MemoryMap::trackingThreshold(void) {
+  return _tracking_threshold;
 }
 
 void *MemoryMap::handle_malloc(size_t size) {
@@ -120,14 +278,9 @@ void *MemoryMap::handle_malloc(size_t size) {
   void *end = reinterpret_cast<void*>(reinterpret_cast<intptr_t>(result) + size
       - 1);
 
-  // update the heap
-  updateHeap();
-
   // if it was not placed in the heap, means it is a new region!
-  if (!_heap->contains(result)) {
-    std::scoped_lock lock(_segments_lock);
-    _segments->emplace_back(start, end, "malloc");
-    Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+  if (!inHeap(result)) {
+    trackSegment(start, end, "malloc");
   }
   return result;
 }
@@ -140,51 +293,55 @@ void* MemoryMap::handle_calloc(size_t nmemb, size_t size) {
   void *end = reinterpret_cast<void*>(reinterpret_cast<intptr_t>(result)
       + (nmemb * size) - 1);
 
-  // update the heap
-  updateHeap();
-
   // if it was not placed in the heap, means it is a new region!
-  if (!_heap->contains(result)) {
-    std::scoped_lock lock(_segments_lock);
-    _segments->emplace_back(start, end, "calloc");
-    Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+  if (!inHeap(result)) {
+    trackSegment(start, end, "calloc");
   }
   return result;
 }
 
 void* MemoryMap::handle_realloc(void *ptr, size_t size) {
   // check if object is in heap before realloc
-  bool was_in_heap = _heap->contains(ptr);
+  bool was_in_heap = ptr == nullptr || inHeap(ptr);
+
+  // a tracked block leaves the memory map before it may be unmapped
+  MemorySegment old(ptr, ptr, "");
+  bool was_tracked = false;
+  if (!was_in_heap) {
+    std::scoped_lock lock(_segments_lock);
+    auto it = findSegment(ptr);
+    if (it != _segments->end()) {
+      old = it->second;
+      was_tracked = true;
+      removeSegment(it);
+    }
+  }
 
   // do the realloc
   void *result = WRAP(realloc)(ptr, size);
 
-  // check if object is in heap after realloc
-  updateHeap();
-  bool is_in_heap = _heap->contains(result);
-
-  // determine if object before was outside the heap
-  if (!was_in_heap) {
-    std::scoped_lock lock(_segments_lock);
-    _segments->remove_if([ptr](const MemorySegment& s) {
-      if (s.contains(ptr)) {
-        std::shared_ptr<Mode> mode = Runtime::getInstance().getMode();
-        mode->processSegmentRemoval(s);
-        return true;
-      }
-      return false;
-    });
+  // the old block is still there if the realloc failed
+  if (result == nullptr) {
+    if (was_tracked && size > 0) {
+      std::scoped_lock lock(_segments_lock);
+      MemorySegment &restored = addSegment(old.startAddress(),
+                                           old.endAddress(), old.name());
+      restored.placement(old.placement());
+      restored.tuning(old.tuning());
+    }
+    return result;
   }
 
+  // check if object is in heap after realloc
+  bool is_in_heap = inHeap(result);
+
   if (!is_in_heap) {
     // compute start and end address
     void *start = result;
     void *end = reinterpret_cast<void*>(reinterpret_cast<intptr_t>(result)
         + size - 1);
     // insert the new segment
-    std::scoped_lock lock(_segments_lock);
-    _segments->emplace_back(start, end, "realloc");
-    Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+    trackSegment(start, end, "realloc");
   }
   return result;
 }
@@ -196,24 +353,18 @@ void* MemoryMap::handle_reallocarray(void *ptr, size_t nmemb, size_t size) {
 }
 
 void MemoryMap::handle_free(void *ptr) {
-  bool was_in_heap = _heap->contains(ptr);
-  WRAP(free)(ptr);
+  // heap chunks are not tracked, the heap end is refreshed lazily
+  if (inHeap(ptr)) {
+    WRAP(free)(ptr);
+    return;
+  }
 
-  // check where the segment was allocated
-  if (was_in_heap) {
-    updateHeap();
-  } else {
-    // if not in heap, remove the mapped segment
+  // if not in heap, remove the mapped segment before it is unmapped
+  {
     std::scoped_lock lock(_segments_lock);
-    _segments->remove_if([ptr](const MemorySegment& s) {
-      if (s.contains(ptr)) {
-        std::shared_ptr<Mode> mode = Runtime::getInstance().getMode();
-        mode->processSegmentRemoval(s);
-        return true;
-      }
-      return false;
-    });
+    removeSegment(ptr);
   }
+  WRAP(free)(ptr);
 }
 
 int MemoryMap::handle_posix_memalign(void **memptr, size_t alignment,
@@ -221,19 +372,14 @@ int MemoryMap::handle_posix_memalign(void **memptr, size_t alignment,
   // call the actual function
   int result = WRAP(posix_memalign)(memptr, alignment, size);
 
-  // update the heap
-  updateHeap();
-
   // compute region start and address
   void *start = *memptr;
   void *end = reinterpret_cast<void*>(reinterpret_cast<intptr_t>(*memptr) + size
       - 1);
 
   // add the new region
-  if (!_heap->contains(*memptr)) {
-    std::scoped_lock lock(_segments_lock);
-    _segments->emplace_back(start, end, "posix_memalign");
-    Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+  if (result == 0 && !inHeap(*memptr)) {
+    trackSegment(start, end, "posix_memalign");
   }
 
   return result;
@@ -249,27 +395,20 @@ void* MemoryMap::handle_mmap(void *addr, size_t length, int prot, int flags,
       + length - 1);
 
   // insert the new segment
-  std::scoped_lock lock(_segments_lock);
-  _segments->emplace_back(start, end, "mmap");
-  Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+  trackSegment(start, end, "mmap");
 
   // return the result
   return result;
 }
 
 int MemoryMap::handle_munmap(void *addr, size_t length) {
+  // remove the mapped region before it is unmapped
+  {
+    std::scoped_lock lock(_segments_lock);
+    removeSegment(addr);
+  }
   int result = WRAP(munmap)(addr, length);
-
-  // remove the mapped region
-  std::scoped_lock lock(_segments_lock);
-  _segments->remove_if([addr](const MemorySegment& s) {
-    if (s.contains(addr)) {
-      std::shared_ptr<Mode> mode = Runtime::getInstance().getMode();
-      mode->processSegmentRemoval(s);
-      return true;
-    }
-    return false;
-  });
+  numa().unmapped(addr, length);
 
   return result;
 }
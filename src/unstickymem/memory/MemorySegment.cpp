@@ -51,6 +51,14 @@ std::string MemorySegment::name() const {
   return _name;
 }
 
+const SegmentPlacement& MemorySegment::placement() const {
+  return _placement;
+}
+
+const SegmentTuning& MemorySegment::tuning() const {
+  return _tuning;
+}
+
 void MemorySegment::startAddress(void *addr) {
   _startAddress = addr;
 }
@@ -63,6 +71,14 @@ void MemorySegment::name(std::string name) {
   _name = name;
 }
 
+void MemorySegment::placement(const SegmentPlacement &placement) {
+  _placement = placement;
+}
+
+void MemorySegment::tuning(const SegmentTuning &tuning) {
+  _tuning = tuning;
+}
+
 void* MemorySegment::pageAlignedStartAddress() const {
   return reinterpret_cast<void*>(PAGE_ALIGN_DOWN(_startAddress));
 }
@@ -0,0 +1,173 @@
+#include <sys/mman.h>
+
+#include <numa.h>
+#include <numaif.h>
+
+#include <chrono>
+#include <thread>
+
+#include "unstickymem/memory/SegmentEventQueue.hpp"
+#include "unstickymem/memory/MemoryMap.hpp"
+#include "unstickymem/Runtime.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+// how long the placement thread sleeps when there are no events
+static const std::chrono::milliseconds DRAINER_IDLE_WAIT(10);
+
+// marks the ring of a thread as retired when the thread exits
+struct RingOwner {
+  void *ring = nullptr;
+  std::atomic<bool> *retired = nullptr;
+  bool exited = false;
+
+  ~RingOwner() {
+    if (retired != nullptr) {
+      retired->store(true, std::memory_order_release);
+    }
+    // late allocations of this thread get a fresh ring per event
+    ring = nullptr;
+    retired = nullptr;
+    exited = true;
+  }
+};
+
+static thread_local RingOwner ring_owner;
+
+SegmentEventQueue& SegmentEventQueue::getInstance(void) {
+  static SegmentEventQueue *object = nullptr;
+  if (!object) {
+    void *buf = WRAP(mmap)(nullptr, sizeof(SegmentEventQueue),
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    DIEIF(buf == MAP_FAILED, "error allocating space for segment events");
+    object = new (buf) SegmentEventQueue();
+  }
+  return *object;
+}
+
+void SegmentEventQueue::configure(bool async, bool first_touch) {
+  _async = async;
+  _first_touch = first_touch;
+}
+
+SegmentEventQueue::Ring* SegmentEventQueue::threadRing() {
+  if (ring_owner.ring != nullptr) {
+    return reinterpret_cast<Ring*>(ring_owner.ring);
+  }
+
+  // create and publish the ring of this thread
+  void *buf = WRAP(mmap)(nullptr, sizeof(Ring), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  DIEIF(buf == MAP_FAILED, "error allocating segment event ring");
+  Ring *ring = new (buf) Ring();
+  ring->next = _rings.load(std::memory_order_relaxed);
+  while (!_rings.compare_exchange_weak(ring->next, ring,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+  }
+  ring_owner.ring = ring;
+  ring_owner.retired = &ring->retired;
+  return ring;
+}
+
+void SegmentEventQueue::applyFirstTouchPolicy(const SegmentEvent &event) {
+  // respect the policy of threads that chose their own
+  int policy;
+  if (get_mempolicy(&policy, nullptr, 0, nullptr, 0) != 0
+      || policy != MPOL_DEFAULT) {
+    return;
+  }
+  // until the placement thread gets to it, the segment is interleaved. only
+  // the untouched pages follow the policy, none are moved
+  struct bitmask *nodes = Runtime::getInstance().getMode()->firstTouchNodes();
+  if (nodes == nullptr || numa_bitmask_weight(nodes) == 0) {
+    return;
+  }
+  uintptr_t start = reinterpret_cast<uintptr_t>(event.start)
+      & ~(static_cast<uintptr_t>(numa_pagesize()) - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(event.end);
+  if (numa().bind(reinterpret_cast<void*>(start), end - start + 1,
+                  MPOL_INTERLEAVE, nodes->maskp, nodes->size + 1, 0) != 0) {
+    LDEBUGF("could not set the first-touch policy of [%p:%p]", event.start,
+            event.end);
+  }
+}
+
+bool SegmentEventQueue::push(const SegmentEvent &event) {
+  if (!_async) {
+    return false;
+  }
+  Ring *ring = threadRing();
+  size_t tail = ring->tail.load(std::memory_order_relaxed);
+  if (tail - ring->head.load(std::memory_order_acquire) == RING_SIZE) {
+    return false;
+  }
+  // before the placement thread can see the segment, or it would undo it
+  if (_first_touch) {
+    applyFirstTouchPolicy(event);
+  }
+  ring->events[tail % RING_SIZE] = event;
+  ring->tail.store(tail + 1, std::memory_order_release);
+
+  // after the thread exited nothing would retire its ring, retire it with
+  // the event in it so that the drainer frees it
+  if (ring_owner.exited) {
+    ring->retired.store(true, std::memory_order_release);
+    ring_owner.ring = nullptr;
+    ring_owner.retired = nullptr;
+  }
+
+  std::call_once(_started, [this] {
+    std::thread drainer(&SegmentEventQueue::drainerThread, this);
+    drainer.detach();
+  });
+  _idle.notify_one();
+  return true;
+}
+
+size_t SegmentEventQueue::drain() {
+  MemoryMap &segments = MemoryMap::getInstance();
+  size_t drained = 0;
+
+  Ring *prev = nullptr;
+  Ring *ring = _rings.load(std::memory_order_acquire);
+  while (ring != nullptr) {
+    // check for retirement first, so no event is left behind
+    bool retired = ring->retired.load(std::memory_order_acquire);
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    size_t tail = ring->tail.load(std::memory_order_acquire);
+    for (; head != tail; head++) {
+      segments.processSegmentEvent(ring->events[head % RING_SIZE]);
+      ring->head.store(head + 1, std::memory_order_release);
+      drained++;
+    }
+
+    // only the drainer unlinks rings; the list head is left to the producers
+    Ring *next = ring->next;
+    if (retired && prev != nullptr) {
+      prev->next = next;
+      ring->~Ring();
+      WRAP(munmap)(ring, sizeof(Ring));
+    } else {
+      prev = ring;
+    }
+    ring = next;
+  }
+  return drained;
+}
+
+void SegmentEventQueue::drainerThread() {
+  LDEBUG("segment placement thread started");
+  while (true) {
+    if (drain() == 0) {
+      std::unique_lock<std::mutex> lock(_idle_lock);
+      _idle.wait_for(lock, DRAINER_IDLE_WAIT);
+    }
+  }
+}
+
+}  // namespace unstickymem
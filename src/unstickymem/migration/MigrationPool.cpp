@@ -0,0 +1,245 @@
+#include <sys/mman.h>
+#include <time.h>
+
+#include <numa.h>
+
+#include <algorithm>
+
+#include "unstickymem/migration/MigrationPool.hpp"
+#include "unstickymem/unstickymem.h"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+// ranges handed to the workers are a few migration batches long, small enough
+// for idle workers to steal and large enough to amortize the queueing
+static const size_t BATCHES_PER_RANGE = 4;
+
+struct MigrationPool::Job {
+  const RangeFunction &fn;
+  std::atomic<size_t> remaining;
+  std::mutex lock;
+  std::condition_variable done;
+  MigrationStats stats;
+
+  Job(const RangeFunction &f, size_t ranges) : fn(f), remaining(ranges) {}
+};
+
+MigrationPool& MigrationPool::getInstance(void) {
+  static MigrationPool *object = nullptr;
+  if (!object) {
+    void *buf = WRAP(mmap)(nullptr, sizeof(MigrationPool),
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    DIEIF(buf == MAP_FAILED, "error allocating space for migration pool");
+    object = new (buf) MigrationPool();
+  }
+  return *object;
+}
+
+void MigrationPool::configure(unsigned int workers_per_node,
+                              double cpu_budget) {
+  DIEIF(cpu_budget <= 0 || cpu_budget > 1,
+        "migration CPU budget must be in ]0, 1]");
+  DIEIF(!_workers.empty(), "migration pool is already running");
+  _workers_per_node = workers_per_node;
+  _cpu_budget = cpu_budget;
+}
+
+size_t MigrationPool::numWorkers() const {
+  return _workers.size();
+}
+
+void MigrationPool::startWorkers() {
+  // only nodes with CPUs can host workers
+  struct bitmask *cpus = numa_allocate_cpumask();
+  for (int i = 0; i < NUM_NODES; i++) {
+    int node = nodes_info[i].id;
+    if (numa_node_to_cpus(node, cpus) < 0 || numa_bitmask_weight(cpus) == 0) {
+      continue;
+    }
+    for (unsigned int w = 0; w < _workers_per_node; w++) {
+      _workers.emplace_back(new Worker());
+      _workers.back()->node = node;
+    }
+  }
+  numa_free_cpumask(cpus);
+
+  for (size_t id = 0; id < _workers.size(); id++) {
+    std::thread worker(&MigrationPool::workerThread, this, id);
+    worker.detach();
+  }
+  LDEBUGF("started %zu migration workers (%u per node, %.0lf%% CPU budget)",
+          _workers.size(), _workers_per_node, _cpu_budget * 100);
+}
+
+void MigrationPool::workerThread(size_t id) {
+  Worker &self = *_workers[id];
+  if (numa_run_on_node(self.node) < 0) {
+    LWARNF("could not pin migration worker %zu to node %d", id, self.node);
+  }
+
+  Range range;
+  while (true) {
+    if (takeRange(id, &range)) {
+      runRange(range);
+      range.job.reset();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_idle_lock);
+    _idle.wait(lock, [this] { return _queued.load() > 0; });
+  }
+}
+
+bool MigrationPool::takeRange(size_t id, Range *range) {
+  // own work first, newest range
+  {
+    Worker &self = *_workers[id];
+    std::lock_guard<std::mutex> lock(self.lock);
+    if (!self.ranges.empty()) {
+      *range = std::move(self.ranges.back());
+      self.ranges.pop_back();
+      _queued--;
+      return true;
+    }
+  }
+  // then steal the oldest range of another worker, same node first
+  for (int pass = 0; pass < 2; pass++) {
+    for (size_t i = 1; i < _workers.size(); i++) {
+      Worker &victim = *_workers[(id + i) % _workers.size()];
+      if ((pass == 0) != (victim.node == _workers[id]->node)) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(victim.lock);
+      if (!victim.ranges.empty()) {
+        *range = std::move(victim.ranges.front());
+        victim.ranges.pop_front();
+        _queued--;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static double now_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void MigrationPool::runRange(const Range &range) {
+  Job &job = *range.job;
+  double before = now_seconds();
+  MigrationStats stats = job.fn(range.first_page, range.num_pages);
+  double busy = now_seconds() - before;
+  {
+    std::lock_guard<std::mutex> lock(job.lock);
+    job.stats.add(stats);
+    if (--job.remaining == 0) {
+      job.done.notify_all();
+    }
+  }
+  // stay within the CPU budget by idling in proportion to the work done
+  if (_cpu_budget < 1) {
+    double pause = busy * (1 / _cpu_budget - 1);
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(pause);
+    ts.tv_nsec = static_cast<long>((pause - ts.tv_sec) * 1e9);
+    nanosleep(&ts, nullptr);
+  }
+}
+
+MigrationStats MigrationPool::run(size_t page_count, size_t range_pages,
+                                  const RangeFunction &fn,
+                                  const std::function<int(size_t)> &node_hint) {
+  if (page_count == 0) {
+    return MigrationStats();
+  }
+  if (_workers_per_node == 0) {
+    return fn(0, page_count);
+  }
+  std::call_once(_started, &MigrationPool::startWorkers, this);
+  if (_workers.empty()) {
+    return fn(0, page_count);
+  }
+
+  const size_t num_ranges = (page_count + range_pages - 1) / range_pages;
+  auto job = std::make_shared<Job>(fn, num_ranges);
+  double before = now_seconds();
+
+  // account for the ranges before they become visible to the workers
+  _queued += num_ranges;
+  std::vector<size_t> next_worker(numa().maxNode() + 1);
+  for (size_t r = 0; r < num_ranges; r++) {
+    Range range { job, r * range_pages,
+                  std::min(range_pages, page_count - r * range_pages) };
+
+    // queue the range on a worker of its preferred node, round robin
+    size_t target = r % _workers.size();
+    int node = node_hint(range.first_page);
+    if (node >= 0 && static_cast<size_t>(node) < next_worker.size()) {
+      size_t skip = next_worker[node]++ % _workers_per_node;
+      for (size_t w = 0; w < _workers.size(); w++) {
+        if (_workers[w]->node == node && skip-- == 0) {
+          target = w;
+          break;
+        }
+      }
+    }
+    std::lock_guard<std::mutex> lock(_workers[target]->lock);
+    _workers[target]->ranges.push_back(std::move(range));
+  }
+  {
+    std::lock_guard<std::mutex> lock(_idle_lock);
+  }
+  _idle.notify_all();
+
+  std::unique_lock<std::mutex> lock(job->lock);
+  job->done.wait(lock, [&job] { return job->remaining.load() == 0; });
+  MigrationStats stats = job->stats;
+  // report wall-clock time, the ranges overlap
+  stats.seconds = now_seconds() - before;
+  return stats;
+}
+
+MigrationStats MigrationPool::migrate(void *start, size_t page_count,
+                                      const PageNodeFunction &node_of) {
+  const size_t pagesize = numa_pagesize();
+  char *pages = reinterpret_cast<char*>(start);
+  RangeFunction fn = [&](size_t first, size_t count) {
+    return migrate_pages(pages + first * pagesize, count,
+                         [&](size_t page) { return node_of(first + page); });
+  };
+  return run(page_count, migration_batch_pages() * BATCHES_PER_RANGE, fn,
+             node_of);
+}
+
+MigrationStats MigrationPool::migrate(void *start, const PlacementPlan &plan,
+                                      const PlacementPlan *before) {
+  const size_t pagesize = numa_pagesize();
+  char *pages = reinterpret_cast<char*>(start);
+  RangeFunction fn = [&](size_t first, size_t count) {
+    // migrate_pages asks for the pages in order
+    PlanCursor after(plan, first);
+    std::unique_ptr<PlanCursor> last;
+    if (before != nullptr) {
+      last = std::make_unique<PlanCursor>(*before, first);
+    }
+    return migrate_pages(pages + first * pagesize, count, [&](size_t) {
+      int node = after.node();
+      bool keep = last && !last->done() && last->node() == node;
+      after.next();
+      if (last && !last->done()) {
+        last->next();
+      }
+      return keep ? KEEP_PAGE : node;
+    });
+  };
+  return run(plan.layout().pages, migration_batch_pages() * BATCHES_PER_RANGE,
+             fn, [&plan](size_t page) { return plan.nodeOfPage(page); });
+}
+
+}  // namespace unstickymem
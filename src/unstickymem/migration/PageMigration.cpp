@@ -0,0 +1,166 @@
+#include <sys/mman.h>
+#include <errno.h>
+#include <time.h>
+
+#include <numa.h>
+#include <numaif.h>
+
+#include <algorithm>
+
+#include "unstickymem/migration/PageMigration.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+static size_t batch_pages = DEFAULT_MIGRATION_BATCH_PAGES;
+
+size_t migration_batch_pages() {
+  return batch_pages;
+}
+
+void migration_batch_pages(size_t pages) {
+  DIEIF(pages == 0, "migration batch must have at least one page");
+  batch_pages = pages;
+}
+
+void MigrationStats::add(const MigrationStats &other) {
+  kept += other.kept;
+  missed += other.missed;
+  absent += other.absent;
+  if (other.batches == 0) {
+    return;
+  }
+  min_batch_rate = batches == 0 ? other.min_batch_rate :
+      std::min(min_batch_rate, other.min_batch_rate);
+  max_batch_rate = std::max(max_batch_rate, other.max_batch_rate);
+  pages += other.pages;
+  batches += other.batches;
+  seconds += other.seconds;
+}
+
+// move_pages arguments, allocated once per thread outside of the tracked heap
+class MigrationBuffers {
+ public:
+  void **addr = nullptr;
+  int *nodes = nullptr;
+  int *status = nullptr;
+  size_t capacity = 0;
+
+  void reserve(size_t pages) {
+    if (pages <= capacity) {
+      return;
+    }
+    release();
+    addr = reinterpret_cast<void**>(allocate(pages * sizeof(void*)));
+    nodes = reinterpret_cast<int*>(allocate(pages * sizeof(int)));
+    status = reinterpret_cast<int*>(allocate(pages * sizeof(int)));
+    capacity = pages;
+  }
+
+  ~MigrationBuffers() {
+    release();
+  }
+
+ private:
+  static void *allocate(size_t len) {
+    void *buf = WRAP(mmap)(nullptr, len, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    DIEIF(buf == MAP_FAILED, "error allocating migration buffers");
+    return buf;
+  }
+
+  void release() {
+    if (capacity == 0) {
+      return;
+    }
+    WRAP(munmap)(addr, capacity * sizeof(void*));
+    WRAP(munmap)(nodes, capacity * sizeof(int));
+    WRAP(munmap)(status, capacity * sizeof(int));
+    capacity = 0;
+  }
+};
+
+static double elapsed_seconds(const struct timespec &from,
+                              const struct timespec &to) {
+  return (to.tv_sec - from.tv_sec) + (to.tv_nsec - from.tv_nsec) / 1e9;
+}
+
+MigrationStats migrate_pages(void *start, size_t page_count,
+                             const PageNodeFunction &node_of) {
+  thread_local static MigrationBuffers buffers;
+  const size_t batch = migration_batch_pages();
+  const int pagesize = numa_pagesize();
+  char *pages = reinterpret_cast<char*>(start);
+  MigrationStats stats;
+
+  buffers.reserve(batch);
+  size_t page = 0;
+  while (page < page_count) {
+    // fill the batch with the pages that have to move
+    size_t count = 0;
+    for (; page < page_count && count < batch; page++) {
+      int node = node_of(page);
+      if (node == KEEP_PAGE) {
+        stats.kept++;
+        continue;
+      }
+      buffers.addr[count] = pages + page * pagesize;
+      buffers.nodes[count] = node;
+      buffers.status[count] = -123;
+      count++;
+    }
+    if (count == 0) {
+      break;
+    }
+
+    struct timespec before, after;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    size_t left = count;
+    for (int attempt = 0; left > 0; attempt++) {
+      long rc = numa().movePages(left, buffers.addr, buffers.nodes,
+                                 buffers.status, MPOL_MF_MOVE);
+      // pages unmapped while the segment was being placed are just missed
+      if (rc < 0 && errno != ENOENT && errno != EFAULT && errno != ENOMEM) {
+        perror("move_pages");
+        exit(1);
+      }
+      // busy pages move to the front for another try
+      size_t busy = 0;
+      for (size_t i = 0; i < left; i++) {
+        int status = buffers.status[i];
+        if (status == buffers.nodes[i]) {
+          continue;
+        }
+        if (status == -ENOENT || status == -EFAULT) {
+          stats.absent++;
+        } else if ((status == -EBUSY || status == -EAGAIN)
+            && attempt < MIGRATION_RETRIES) {
+          buffers.addr[busy] = buffers.addr[i];
+          buffers.nodes[busy] = buffers.nodes[i];
+          busy++;
+        } else {
+          stats.missed++;
+        }
+      }
+      left = busy;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &after);
+
+    double seconds = elapsed_seconds(before, after);
+    double rate = seconds > 0 ? count / seconds : 0;
+    LTRACEF("batch %zu: %zu pages in %.3lfms (%.0lf pages/s)", stats.batches,
+            count, seconds * 1000, rate);
+    stats.min_batch_rate = stats.batches == 0 ? rate :
+        std::min(stats.min_batch_rate, rate);
+    stats.max_batch_rate = std::max(stats.max_batch_rate, rate);
+    stats.pages += count;
+    stats.batches++;
+    stats.seconds += seconds;
+  }
+  return stats;
+}
+
+}  // namespace unstickymem
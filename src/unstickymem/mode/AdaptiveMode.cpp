@@ -5,6 +5,7 @@
 #include <numa.h>
 #include <numaif.h>
 
+#include <cmath>
 #include <thread>
 
 #include <boost/program_options.hpp>
@@ -12,9 +13,12 @@
 #include "unstickymem/PerformanceCounters.hpp"
 #include "unstickymem/unstickymem.h"
 #include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/PlacementCache.hpp"
 #include "unstickymem/Logger.hpp"
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/mode/AdaptiveMode.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
+#include "unstickymem/search/SearchStrategy.hpp"
 
 namespace unstickymem {
 
@@ -35,7 +39,24 @@ po::options_description AdaptiveMode::getOptions() {
       "How many of the top-N and bottom-N measurements to discard")(
       "UNSTICKYMEM_POLL_SLEEP",
       po::value < useconds_t > (&_poll_sleep)->default_value(200000),
-      "Time (in microseconds) between measurements");
+      "Time (in microseconds) between measurements")(
+      "UNSTICKYMEM_MAX_POLLS",
+      po::value<unsigned int>(&_max_polls)->default_value(60),
+      "How many measurements to make at most when a ratio cannot be told "
+      "apart from the best one")(
+      "UNSTICKYMEM_SIGNIFICANCE",
+      po::value<double>(&_significance)->default_value(0.05),
+      "Significance level of the test comparing two ratios")(
+      "UNSTICKYMEM_SEARCH",
+      po::value<std::string>(&_search)->default_value("linear"),
+      "How to search for the best ratio (linear, golden, halving, bayesian)")(
+      "UNSTICKYMEM_SEARCH_RESOLUTION",
+      po::value<double>(&_search_resolution)->default_value(
+          ADAPTATION_STEP / 100.0),
+      "Smallest ratio difference the search looks at")(
+      "UNSTICKYMEM_SEARCH_MAX_STEPS",
+      po::value<unsigned int>(&_search_max_steps)->default_value(10),
+      "Most ratios the golden and bayesian searches evaluate");
   return mode_options;
 }
 
@@ -44,15 +65,115 @@ void AdaptiveMode::printParameters() {
   LINFOF("UNSTICKYMEM_NUM_POLLS:          %lu", _num_polls);
   LINFOF("UNSTICKYMEM_NUM_POLL_OUTLIERS:  %lu", _num_poll_outliers);
   LINFOF("UNSTICKYMEM_POLL_SLEEP:         %lu", _poll_sleep);
+  LINFOF("UNSTICKYMEM_MAX_POLLS:          %lu", _max_polls);
+  LINFOF("UNSTICKYMEM_SIGNIFICANCE:       %lf", _significance);
+  LINFOF("UNSTICKYMEM_SEARCH:             %s", _search.c_str());
+  LINFOF("UNSTICKYMEM_SEARCH_RESOLUTION:  %lf", _search_resolution);
+  LINFOF("UNSTICKYMEM_SEARCH_MAX_STEPS:   %lu", _search_max_steps);
 }
 
-void AdaptiveMode::adaptiveThread() {
-  // start with everything interleaved
-  double local_ratio = 1.0 / numa_num_configured_nodes();
-  double prev_stall_rate = std::numeric_limits<double>::infinity();
-  double best_stall_rate = std::numeric_limits<double>::infinity();
-  double stall_rate;
+StallComparison AdaptiveMode::compare(StallStats *current,
+                                       const StallStats &other) {
+  // keep sampling while the difference is within the noise
+  return StallRateSampler::getInstance().compare(current, other,
+                                                 _significance, _max_polls,
+                                                 _num_polls,
+                                                 _num_poll_outliers);
+}
+
+StallStats AdaptiveMode::evaluate(double ratio, double effort) {
+  LINFOF("going to check a ratio of %3.1lf%%", ratio * 100);
+  place_all_pages_adaptive(MemoryMap::getInstance(), ratio);
+  _placed_ratio = ratio;
+  usleep(200000);
+  unstickymem_log(ratio);
+
+  // shorter windows keep the same share of outliers
+  size_t polls = std::max<size_t>(std::lround(_num_polls * effort),
+                                  MIN_SAMPLER_SAMPLES);
+  size_t outliers = std::lround(_num_poll_outliers * effort);
+  get_node_bandwidth();
+  StallStats stats = get_stall_stats(polls, _poll_sleep, outliers);
+  std::vector<double> bandwidth = get_node_bandwidth();
+  double stall_rate = stats.trimmed_mean;
+  //print stall_rate to a file for debugging!
+  unstickymem_log(ratio, stall_rate);
+
+  _best_stall_rate = std::min(_best_stall_rate, stall_rate);
+  LINFOF("Ratio: %1.2lf StallRate: %1.10lf (previous %1.10lf; best %1.10lf)",
+         ratio, stall_rate, _prev_stall_rate, _best_stall_rate);
+  LDEBUGF("Mean: %1.10lf +- %1.10lf over %zu samples", stats.mean,
+          stats.confidence(), stats.count);
+  std::vector<double> node_rates = get_average_node_stall_rates();
+  for (size_t node = 0; node < node_rates.size(); node++) {
+    if (!std::isnan(node_rates[node])) {
+      LDEBUGF("Node %zu StallRate: %1.10lf", node, node_rates[node]);
+    }
+  }
+  for (size_t node = 0; node < bandwidth.size(); node++) {
+    if (!std::isnan(bandwidth[node])) {
+      LDEBUGF("Node %zu Bandwidth: %.2lf GB/s", node, bandwidth[node] / 1e9);
+    }
+  }
+  _prev_stall_rate = stall_rate;
+  return stats;
+}
+
+bool AdaptiveMode::validateRatio(double ratio, const SearchSpace &space) {
+  LINFOF("re-validating the cached ratio %1.2lf", ratio);
+  StallStats cached = evaluate(ratio, 1.0);
+  for (double neighbour : { ratio - space.resolution,
+                            ratio + space.resolution }) {
+    if (neighbour < space.low - 1e-9 || neighbour > space.high + 1e-9) {
+      continue;
+    }
+    StallStats stats = evaluate(neighbour, 1.0);
+    if (compare(&stats, cached) == StallComparison::LOWER) {
+      LINFOF("ratio %1.2lf does better, the cached ratio is stale",
+             neighbour);
+      return false;
+    }
+  }
+  return true;
+}
+
+SearchSpace AdaptiveMode::searchSpace() const {
+  // slowly achieve awesomeness, starting with everything interleaved
+  SearchSpace space;
+  space.low = ((100 / numa().configuredNodes() + 4) / 5 * 5) / 100.0;
+  space.high = 1.0;
+  space.resolution = _search_resolution;
+  space.max_steps = _search_max_steps;
+  return space;
+}
 
+double AdaptiveMode::findRatio() {
+  SearchSpace space = searchSpace();
+
+  // a ratio found by an earlier run of the same program only gets checked
+  std::string key = workload_key();
+  CachedPlacement cached;
+  double local_ratio;
+  if (load_cached_placement(key, &cached) && cached.ratio >= space.low
+      && cached.ratio <= space.high && validateRatio(cached.ratio, space)) {
+    local_ratio = cached.ratio;
+  } else {
+    std::unique_ptr<SearchStrategy> strategy = SearchStrategy::getStrategy(
+        _search);
+    local_ratio = strategy->search(*this, space);
+  }
+  cached.ratio = local_ratio;
+  store_cached_placement(key, cached);
+
+  // the search may have stopped elsewhere
+  if (local_ratio != _placed_ratio) {
+    place_all_pages_adaptive(MemoryMap::getInstance(), local_ratio);
+    _placed_ratio = local_ratio;
+  }
+  return local_ratio;
+}
+
+void AdaptiveMode::adaptiveThread() {
   // pin thread to core zero
   // FIXME(dgureya): is this required when using likwid? - I don't think so!
   // cpu_set_t mask;
@@ -65,49 +186,10 @@ void AdaptiveMode::adaptiveThread() {
   get_elapsed_stall_rate();
   sleep(_wait_start);
 
-  // dump mapping information
-  MemoryMap &segments = MemoryMap::getInstance();
-  // segments.print();
-
-  // slowly achieve awesomeness
-  for (uint64_t local_percentage = (100 / numa_num_configured_nodes() + 4) / 5
-      * 5; local_percentage <= 100; local_percentage += ADAPTATION_STEP) {
-    if (local_percentage % 10 == 0 && local_percentage != 100)
-      continue;
-    local_ratio = ((double) local_percentage) / 100;
-    LINFOF("going to check a ratio of %3.1lf%%", local_ratio * 100);
-    place_all_pages_adaptive(segments, local_ratio);
-    usleep(200000);
-    unstickymem_log(local_ratio);
-    stall_rate = get_average_stall_rate(_num_polls, _poll_sleep,
-                                        _num_poll_outliers);
-    //print stall_rate to a file for debugging!
-    unstickymem_log(local_ratio, stall_rate);
-
-    LINFOF("Ratio: %1.2lf StallRate: %1.10lf (previous %1.10lf; best %1.10lf)",
-           local_ratio, stall_rate, prev_stall_rate, best_stall_rate);
-    /*std::string s = std::to_string(stall_rate);
-     s.replace(s.find("."), std::string(".").length(), ",");
-     fprintf(stderr, "%s\n", s.c_str());*/
-    // compute the minimum rate
-    best_stall_rate = std::min(best_stall_rate, stall_rate);
-    // check if we are getting worse
-    if (stall_rate > best_stall_rate * 1.001) {
-      // just make sure that its not something transient...!
-      LINFO("Hmm... Is this the best we can do?");
-      if (get_average_stall_rate(_num_polls * 2, _poll_sleep,
-                                 _num_poll_outliers * 2)
-          > (best_stall_rate * 1.001)) {
-        LINFO("I guess so!");
-        break;
-      }
-    }
-    prev_stall_rate = stall_rate;
-  }
+  double local_ratio = findRatio();
   LINFO("My work here is done! Enjoy the speedup");
   LINFOF("Ratio: %1.2lf", local_ratio);
-  LINFOF("Stall Rate: %1.10lf", stall_rate);
-  LINFOF("Best Measured Stall Rate: %1.10lf", best_stall_rate);
+  LINFOF("Best Measured Stall Rate: %1.10lf", _best_stall_rate);
 }
 
 void AdaptiveMode::start() {
@@ -0,0 +1,123 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/counters/ChangeDetector.hpp"
+#include "unstickymem/memory/MemoryMap.hpp"
+#include "unstickymem/mode/ContinuousMode.hpp"
+
+namespace unstickymem {
+
+static Mode::Registrar<ContinuousMode> registrar(ContinuousMode::name(),
+                                                 ContinuousMode::description());
+
+po::options_description ContinuousMode::getOptions() {
+  po::options_description mode_options = AdaptiveMode::getOptions();
+  po::options_description continuous_options("Continuous mode parameters");
+  continuous_options.add_options()(
+      "UNSTICKYMEM_CHANGE_DELTA",
+      po::value<double>(&_change_delta)->default_value(0.05),
+      "Drift of the stall rate (relative to the phase's level) the change "
+      "detector tolerates per observation")(
+      "UNSTICKYMEM_CHANGE_THRESHOLD",
+      po::value<double>(&_change_threshold)->default_value(1.0),
+      "Accumulated relative drift of the stall rate that signals a new "
+      "phase")(
+      "UNSTICKYMEM_MIN_DWELL",
+      po::value<unsigned int>(&_min_dwell)->default_value(30),
+      "Least time (in seconds) between two searches")(
+      "UNSTICKYMEM_RESEARCH_RADIUS",
+      po::value<double>(&_research_radius)->default_value(0.2),
+      "How far from the current ratio the search after a phase change "
+      "looks");
+  mode_options.add(continuous_options);
+  return mode_options;
+}
+
+void ContinuousMode::printParameters() {
+  AdaptiveMode::printParameters();
+  LINFOF("UNSTICKYMEM_CHANGE_DELTA:       %lf", _change_delta);
+  LINFOF("UNSTICKYMEM_CHANGE_THRESHOLD:   %lf", _change_threshold);
+  LINFOF("UNSTICKYMEM_MIN_DWELL:          %lu", _min_dwell);
+  LINFOF("UNSTICKYMEM_RESEARCH_RADIUS:    %lf", _research_radius);
+}
+
+double ContinuousMode::observe() {
+  return get_stall_stats(MIN_SAMPLER_SAMPLES, _poll_sleep, 0).mean;
+}
+
+double ContinuousMode::readapt(double ratio) {
+  // the current ratio, measured in the new phase
+  StallStats current = evaluate(ratio, 1.0);
+
+  SearchSpace space = searchSpace();
+  space.low = std::max(space.low, ratio - _research_radius);
+  space.high = std::min(space.high, ratio + _research_radius);
+  std::unique_ptr<SearchStrategy> strategy = SearchStrategy::getStrategy(
+      _search);
+  double next = strategy->search(*this, space);
+
+  // hysteresis: moving the pages again must pay off measurably
+  if (std::fabs(next - ratio) >= space.resolution / 2) {
+    StallStats stats = evaluate(next, 1.0);
+    if (compare(&stats, current) == StallComparison::LOWER) {
+      return next;
+    }
+    LINFOF("%1.2lf is not significantly better than %1.2lf, staying", next,
+           ratio);
+  }
+  if (_placed_ratio != ratio) {
+    place_all_pages_adaptive(MemoryMap::getInstance(), ratio);
+    _placed_ratio = ratio;
+  }
+  return ratio;
+}
+
+void ContinuousMode::continuousThread() {
+  get_stall_rate_v2();
+  get_elapsed_stall_rate();
+  sleep(_wait_start);
+
+  double ratio = findRatio();
+  LINFOF("Ratio: %1.2lf, watching for phase changes", ratio);
+
+  ChangeDetector detector(_change_delta, _change_threshold);
+  while (true) {
+    auto searched = std::chrono::steady_clock::now();
+
+    // level of the current phase at the current placement, the
+    // observations are relative to it
+    double level = get_stall_stats(_num_polls, _poll_sleep,
+                                   _num_poll_outliers).trimmed_mean;
+    double scale = level != 0 ? std::fabs(level) : 1;
+    detector.reset();
+    double rate;
+    do {
+      rate = observe();
+    } while (!detector.add((rate - level) / scale));
+    LINFOF("Phase change: stall rate %1.10lf, was %1.10lf", rate, level);
+
+    // hysteresis: short phases are not worth a search
+    auto dwell = searched + std::chrono::seconds(_min_dwell);
+    if (std::chrono::steady_clock::now() < dwell) {
+      std::this_thread::sleep_until(dwell);
+    }
+    ratio = readapt(ratio);
+    LINFOF("Ratio: %1.2lf", ratio);
+  }
+}
+
+void ContinuousMode::start() {
+  std::thread continuousThread(&ContinuousMode::continuousThread, this);
+  continuousThread.detach();
+}
+
+}  // namespace unstickymem
@@ -54,6 +54,10 @@ void ScanMode::printParameters() {
          _exit_when_finished ? "Yes" : "No");
 }
 
+struct bitmask* ScanMode::firstTouchNodes() {
+  return weighted_nodes_nodemask();
+}
+
 void ScanMode::processSegmentAddition(const MemorySegment& segment) {
 
   if (segment.length() > (1UL << 14)) {
@@ -115,13 +119,11 @@ void ScanMode::start() {
    set_mempolicy(MPOL_INTERLEAVE, numa_get_mems_allowed()->maskp,
    numa_get_mems_allowed()->size);*/
 
-  MemoryMap &segments = MemoryMap::getInstance();
-  for (auto &segment : segments) {
-    if (segment.length() > (1UL << 14)) {
-      // segment.print();
-      place_pages_weighted_initial(segment);
-    }
-  }
+  place_segments(MemoryMap::getInstance(), 1UL << 14,
+                 [](MemorySegment &segment) {
+    place_pages_weighted_initial(segment);
+    segment.placement(SegmentPlacement());
+  });
 
   return;
 
@@ -0,0 +1,247 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include "unstickymem/unstickymem.h"
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/memory/MemoryMap.hpp"
+#include "unstickymem/mode/SegmentTuningMode.hpp"
+
+namespace unstickymem {
+
+static Mode::Registrar<SegmentTuningMode> registrar(
+    SegmentTuningMode::name(), SegmentTuningMode::description());
+
+// segments below this size keep the bandwidth weights
+static const size_t MIN_TUNED_LENGTH = 1ULL << 20;
+
+po::options_description SegmentTuningMode::getOptions() {
+  po::options_description mode_options("Segment tuning mode parameters");
+  mode_options.add_options()(
+      "UNSTICKYMEM_WAIT_START",
+      po::value<unsigned int>(&_wait_start)->default_value(2),
+      "Time (in seconds) to wait before starting to tune")(
+      "UNSTICKYMEM_NUM_POLLS",
+      po::value<unsigned int>(&_num_polls)->default_value(20),
+      "How many measurements to make for each placement")(
+      "UNSTICKYMEM_NUM_POLL_OUTLIERS",
+      po::value<unsigned int>(&_num_poll_outliers)->default_value(5),
+      "How many of the top-N and bottom-N measurements to discard")(
+      "UNSTICKYMEM_POLL_SLEEP",
+      po::value < useconds_t > (&_poll_sleep)->default_value(200000),
+      "Time (in microseconds) between measurements")(
+      "UNSTICKYMEM_MAX_POLLS",
+      po::value<unsigned int>(&_max_polls)->default_value(60),
+      "How many measurements to make at most when two placements cannot "
+      "be told apart")(
+      "UNSTICKYMEM_SIGNIFICANCE",
+      po::value<double>(&_significance)->default_value(0.05),
+      "Significance level of the test comparing two placements")(
+      "UNSTICKYMEM_TOP_SEGMENTS",
+      po::value<unsigned int>(&_top_segments)->default_value(4),
+      "How many of the largest segments get a placement of their own")(
+      "UNSTICKYMEM_SEGMENT_STEP",
+      po::value<double>(&_step)->default_value(0.25),
+      "Mix change of the first probes on each segment")(
+      "UNSTICKYMEM_SEGMENT_MIN_STEP",
+      po::value<double>(&_min_step)->default_value(0.05),
+      "A segment is tuned once its step falls below this")(
+      "UNSTICKYMEM_SEGMENT_ROUNDS",
+      po::value<unsigned int>(&_max_rounds)->default_value(10),
+      "Most rounds over the largest segments");
+  return mode_options;
+}
+
+void SegmentTuningMode::printParameters() {
+  LINFOF("UNSTICKYMEM_WAIT_START:         %lu", _wait_start);
+  LINFOF("UNSTICKYMEM_NUM_POLLS:          %lu", _num_polls);
+  LINFOF("UNSTICKYMEM_NUM_POLL_OUTLIERS:  %lu", _num_poll_outliers);
+  LINFOF("UNSTICKYMEM_POLL_SLEEP:         %lu", _poll_sleep);
+  LINFOF("UNSTICKYMEM_MAX_POLLS:          %lu", _max_polls);
+  LINFOF("UNSTICKYMEM_SIGNIFICANCE:       %lf", _significance);
+  LINFOF("UNSTICKYMEM_TOP_SEGMENTS:       %lu", _top_segments);
+  LINFOF("UNSTICKYMEM_SEGMENT_STEP:       %lf", _step);
+  LINFOF("UNSTICKYMEM_SEGMENT_MIN_STEP:   %lf", _min_step);
+  LINFOF("UNSTICKYMEM_SEGMENT_ROUNDS:     %lu", _max_rounds);
+}
+
+std::vector<double> SegmentTuningMode::weights(double mix) const {
+  std::vector<double> weights(_bandwidth_weights.size());
+  for (size_t node = 0; node < weights.size(); node++) {
+    weights[node] = (1 - mix) * _local_weights[node]
+        + mix * _bandwidth_weights[node];
+  }
+  return weights;
+}
+
+bool SegmentTuningMode::place(MemorySegment *segment, double mix) {
+  MemoryMap &segments = MemoryMap::getInstance();
+  SegmentTuning tuning = segment->tuning();
+  if (!segments.copySegment(segment->startAddress(), segment)) {
+    return false;
+  }
+  segment->tuning(tuning);
+  move_pages_weighted(*segment, weights(mix));
+  return segments.updateSegment(*segment);
+}
+
+StallStats SegmentTuningMode::measure() {
+  usleep(200000);
+  StallStats stats = get_stall_stats(_num_polls, _poll_sleep,
+                                     _num_poll_outliers);
+  LDEBUGF("StallRate: %1.10lf +- %1.10lf over %zu samples", stats.mean,
+          stats.confidence(), stats.count);
+  return stats;
+}
+
+bool SegmentTuningMode::tuneSegment(void *start, StallStats *current) {
+  MemorySegment segment(start, start, "");
+  if (!MemoryMap::getInstance().copySegment(start, &segment)) {
+    return false;
+  }
+  SegmentTuning tuning = segment.tuning();
+
+  // a step either way, the other segments stay where they are
+  double best_mix = tuning.mix;
+  StallStats best = *current;
+  for (double mix : { tuning.mix - tuning.step, tuning.mix + tuning.step }) {
+    if (mix < -1e-9 || mix > 1 + 1e-9) {
+      continue;
+    }
+    mix = std::min(std::max(mix, 0.0), 1.0);
+    if (!place(&segment, mix)) {
+      return false;
+    }
+    // keep sampling while the difference is within the noise
+    StallStats stats = measure();
+    StallComparison verdict = StallRateSampler::getInstance().compare(
+        &stats, *current, _significance, _max_polls, _num_polls,
+        _num_poll_outliers);
+    if (verdict == StallComparison::LOWER && stats.mean < best.mean) {
+      best_mix = mix;
+      best = stats;
+    }
+  }
+
+  bool moved = best_mix != tuning.mix;
+  if (moved) {
+    tuning.benefit = (current->mean - best.mean) / std::fabs(current->mean);
+    LINFOF("segment %p: mix %1.2lf -> %1.2lf (%+1.2lf%%)", start, tuning.mix,
+           best_mix, -tuning.benefit * 100);
+    tuning.mix = best_mix;
+    *current = best;
+  } else {
+    tuning.benefit = 0;
+    tuning.step /= 2;
+  }
+  segment.tuning(tuning);
+  place(&segment, tuning.mix);
+  return moved;
+}
+
+void SegmentTuningMode::tuningThread() {
+  get_stall_rate_v2();
+  sleep(_wait_start);
+
+  // the segments go from the local nodes (mix 0) to the bandwidth weights
+  // (mix 1), where the weighted placement put them
+  _bandwidth_weights = node_weights();
+  _local_weights = _bandwidth_weights;
+  double local_sum = 0;
+  for (size_t node = 0; node < _local_weights.size(); node++) {
+    if (!is_worker_node(node)) {
+      _local_weights[node] = 0;
+    }
+    local_sum += _local_weights[node];
+  }
+  if (local_sum <= 0) {
+    _local_weights = _bandwidth_weights;
+  }
+
+  MemoryMap &segments = MemoryMap::getInstance();
+  StallStats current;
+  bool measured = false;
+  for (unsigned int round = 0; round < _max_rounds; round++) {
+    // segments that grew into the top since the last round join in
+    std::vector<void*> top = segments.largestSegments(_top_segments,
+                                                      MIN_TUNED_LENGTH);
+    std::vector<MemorySegment> tuned;
+    for (void *start : top) {
+      MemorySegment segment(start, start, "");
+      if (!segments.copySegment(start, &segment)) {
+        continue;
+      }
+      if (segment.tuning().mix < 0) {
+        SegmentTuning tuning;
+        tuning.mix = 1;
+        tuning.step = _step;
+        segment.tuning(tuning);
+        place(&segment, tuning.mix);
+        measured = false;
+      }
+      tuned.push_back(segment);
+    }
+    if (!measured) {
+      current = measure();
+      measured = true;
+    }
+
+    LINFOF("segment tuning round %u: %zu segments, stall rate %1.10lf",
+           round, tuned.size(), current.mean);
+    bool moved = false;
+    bool tuning = false;
+    for (const MemorySegment &segment : tuned) {
+      if (segment.tuning().step >= _min_step) {
+        tuning = true;
+        moved |= tuneSegment(segment.startAddress(), &current);
+      }
+    }
+    if (!tuning) {
+      break;
+    }
+    LDEBUGF("round %u %s", round, moved ? "moved some segments" :
+            "halved the steps");
+  }
+
+  LINFO("My work here is done! Enjoy the speedup");
+  for (void *start : segments.largestSegments(_top_segments,
+                                              MIN_TUNED_LENGTH)) {
+    MemorySegment segment(start, start, "");
+    if (segments.copySegment(start, &segment)) {
+      LINFOF("segment [%p:%p] %zu MB: mix %1.2lf, last benefit %+1.2lf%%",
+             segment.startAddress(), segment.endAddress(),
+             segment.length() >> 20, segment.tuning().mix,
+             segment.tuning().benefit * 100);
+    }
+  }
+}
+
+void SegmentTuningMode::start() {
+  // start tuning thread
+  std::thread tuningThread(&SegmentTuningMode::tuningThread, this);
+
+  // dont want for it to finish
+  tuningThread.detach();
+}
+
+void SegmentTuningMode::startMemInit() {
+}
+
+struct bitmask* SegmentTuningMode::firstTouchNodes() {
+  return weighted_nodes_nodemask();
+}
+
+void SegmentTuningMode::processSegmentAddition(const MemorySegment& segment) {
+  // untuned segments start from the bandwidth weights
+  if (segment.length() > (1UL << 14)) {
+    place_pages_weighted_initial(segment);
+  }
+}
+
+}  // namespace unstickymem
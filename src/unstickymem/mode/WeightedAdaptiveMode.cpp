@@ -12,6 +12,7 @@
 #include "unstickymem/unstickymem.h"
 #include "unstickymem/PerformanceCounters.hpp"
 #include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/PlacementCache.hpp"
 #include "unstickymem/Logger.hpp"
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/mode/WeightedAdaptiveMode.hpp"
@@ -38,7 +39,26 @@ po::options_description WeightedAdaptiveMode::getOptions() {
       "How many of the top-N and bottom-N measurements to discard")(
       "UNSTICKYMEM_POLL_SLEEP",
       po::value < useconds_t > (&_poll_sleep)->default_value(200000),
-      "Time (in microseconds) between measurements");
+      "Time (in microseconds) between measurements")(
+      "UNSTICKYMEM_MAX_POLLS",
+      po::value<unsigned int>(&_max_polls)->default_value(60),
+      "How many measurements to make at most when two placements cannot "
+      "be told apart")(
+      "UNSTICKYMEM_SIGNIFICANCE",
+      po::value<double>(&_significance)->default_value(0.05),
+      "Significance level of the test comparing two placements")(
+      "UNSTICKYMEM_TUNE_WEIGHTS",
+      po::value<bool>(&_tune_weights)->default_value(false),
+      "Tune the per-node weights while the application runs")(
+      "UNSTICKYMEM_TUNER_STEP",
+      po::value<double>(&_tuner.step)->default_value(5),
+      "Weight points moved by the first steps of the weight tuner")(
+      "UNSTICKYMEM_TUNER_MIN_STEP",
+      po::value<double>(&_tuner.min_step)->default_value(1),
+      "The weight tuner stops once its step falls below this")(
+      "UNSTICKYMEM_TUNER_ITERATIONS",
+      po::value<unsigned int>(&_tuner.max_iterations)->default_value(10),
+      "Most gradient steps of the weight tuner");
   return mode_options;
 }
 
@@ -47,6 +67,39 @@ void WeightedAdaptiveMode::printParameters() {
   LINFOF("UNSTICKYMEM_NUM_POLLS:          %lu", _num_polls);
   LINFOF("UNSTICKYMEM_NUM_POLL_OUTLIERS:  %lu", _num_poll_outliers);
   LINFOF("UNSTICKYMEM_POLL_SLEEP:         %lu", _poll_sleep);
+  LINFOF("UNSTICKYMEM_MAX_POLLS:          %lu", _max_polls);
+  LINFOF("UNSTICKYMEM_SIGNIFICANCE:       %lf", _significance);
+  LINFOF("UNSTICKYMEM_TUNE_WEIGHTS:       %s", _tune_weights ? "yes" : "no");
+  LINFOF("UNSTICKYMEM_TUNER_STEP:         %lf", _tuner.step);
+  LINFOF("UNSTICKYMEM_TUNER_MIN_STEP:     %lf", _tuner.min_step);
+  LINFOF("UNSTICKYMEM_TUNER_ITERATIONS:   %lu", _tuner.max_iterations);
+}
+
+StallStats WeightedAdaptiveMode::evaluate(const std::vector<double> &weights) {
+  place(weights);
+  usleep(200000);
+  StallStats stats = get_stall_stats(_num_polls, _poll_sleep,
+                                     _num_poll_outliers);
+  LDEBUGF("StallRate: %1.10lf +- %1.10lf over %zu samples", stats.mean,
+          stats.confidence(), stats.count);
+  return stats;
+}
+
+void WeightedAdaptiveMode::place(const std::vector<double> &weights) {
+  place_all_pages_weighted(MemoryMap::getInstance(), weights);
+}
+
+StallComparison WeightedAdaptiveMode::compare(StallStats *current,
+                                              const StallStats &other) {
+  // keep sampling while the difference is within the noise
+  return StallRateSampler::getInstance().compare(current, other,
+                                                 _significance, _max_polls,
+                                                 _num_polls,
+                                                 _num_poll_outliers);
+}
+
+struct bitmask* WeightedAdaptiveMode::firstTouchNodes() {
+  return weighted_nodes_nodemask();
 }
 
 void WeightedAdaptiveMode::processSegmentAddition(
@@ -71,6 +124,21 @@ void WeightedAdaptiveMode::adaptiveThread() {
    get_stall_rate_v2();
    //get_elapsed_stall_rate();
    sleep(_wait_start);*/
+  // weights tuned by an earlier run of the same program are used from the
+  // start, and only re-validated with the smallest step
+  std::string key = workload_key();
+  CachedPlacement cached;
+  WeightTunerParameters parameters = _tuner;
+  std::vector<double> weights = node_weights();
+  if (_tune_weights && load_cached_placement(key, &cached)
+      && cached.weights.size() == weights.size()) {
+    LINFO("using the cached weights");
+    weights = cached.weights;
+    set_node_weights(weights);
+    place(weights);
+    parameters.step = parameters.min_step;
+  }
+
   // dump mapping information
   MemoryMap &segments = MemoryMap::getInstance();
 
@@ -111,8 +179,9 @@ void WeightedAdaptiveMode::adaptiveThread() {
 
     LINFOF("Process processID: %d", processID);
 
-    for (auto &mem_segment : segments) {
-      if (mem_segment.length() > 1ULL << 20) {
+    for (void *start : segments.largestSegments(SIZE_MAX, 1ULL << 20)) {
+      MemorySegment mem_segment(start, start, "");
+      if (segments.copySegment(start, &mem_segment)) {
         MySharedMemory sharedmemory(mem_segment.pageAlignedStartAddress(),
                                     mem_segment.pageAlignedLength(), processID);
         myvector->push_back(sharedmemory);
@@ -139,6 +208,17 @@ void WeightedAdaptiveMode::adaptiveThread() {
 
   LINFO("MySharedMemory successfully created!");
 
+  // tune the weights in place of the external controller
+  if (_tune_weights) {
+    get_stall_rate_v2();
+    sleep(_wait_start);
+    WeightTuner tuner(parameters);
+    cached.weights = tuner.tune(*this, weights);
+    // segments added from now on are placed with the tuned weights too
+    set_node_weights(cached.weights);
+    store_cached_placement(key, cached);
+  }
+
   //double i = 50;
   /*LINFO("Moving forward!");
    for (double i = 0; i <= 100; i += ADAPTATION_STEP) {
@@ -253,14 +333,12 @@ void WeightedAdaptiveMode::startMemInit() {
 }
 
 void WeightedAdaptiveMode::memInitThread() {
-  MemoryMap &segments = MemoryMap::getInstance();
   while (MEM_INIT == 0) {
-    for (auto &segment : segments) {
-      if (segment.length() > (1UL << 14)) {
-        // segment.print();
-        place_pages_weighted_initial(segment);
-      }
-    }
+    place_segments(MemoryMap::getInstance(), 1UL << 14,
+                   [](MemorySegment &segment) {
+      place_pages_weighted_initial(segment);
+      segment.placement(SegmentPlacement());
+    });
     sleep(1);
   }
 }
@@ -0,0 +1,60 @@
+#include <numa.h>
+#include <numaif.h>
+
+#include "unstickymem/numa/LinuxNuma.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+static NumaBackend::Registrar<LinuxNuma> registrar(LinuxNuma::name(),
+                                                   LinuxNuma::description());
+
+int LinuxNuma::configuredNodes() {
+  return numa_num_configured_nodes();
+}
+
+int LinuxNuma::maxNode() {
+  return numa_max_node();
+}
+
+bool LinuxNuma::nodeExists(int node) {
+  return numa_bitmask_isbitset(numa_all_nodes_ptr, node);
+}
+
+int LinuxNuma::nodeOfCpu(int cpu) {
+  return numa_node_of_cpu(cpu);
+}
+
+int LinuxNuma::distance(int from, int to) {
+  return numa_distance(from, to);
+}
+
+bool LinuxNuma::hasMemory(int node) {
+  // nodes outside our cpuset cannot receive pages either
+  struct bitmask *allowed = numa_get_mems_allowed();
+  bool result = numa_bitmask_isbitset(allowed, node)
+      && numa_node_size64(node, nullptr) > 0;
+  numa_bitmask_free(allowed);
+  return result;
+}
+
+struct bitmask *LinuxNuma::runNodes() {
+  return numa_get_run_node_mask();
+}
+
+struct bitmask *LinuxNuma::parseNodes(const char *list) {
+  return numa_parse_nodestring(list);
+}
+
+long LinuxNuma::bind(void *addr, unsigned long len, int mode,
+                     const unsigned long *nodemask, unsigned long maxnode,
+                     unsigned flags) {
+  return WRAP(mbind)(addr, len, mode, nodemask, maxnode, flags);
+}
+
+long LinuxNuma::movePages(unsigned long count, void **pages, const int *nodes,
+                          int *status, int flags) {
+  return move_pages(0, count, pages, nodes, status, flags);
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,23 @@
+#include <cstdlib>
+#include <mutex>
+
+#include "unstickymem/numa/NumaBackend.hpp"
+
+namespace unstickymem {
+
+std::map<std::string, NumaBackend::Description> & NumaBackend::registry() {
+  static std::map<std::string, NumaBackend::Description> r;
+  return r;
+}
+
+NumaBackend& numa(void) {
+  static std::unique_ptr<NumaBackend> backend;
+  static std::once_flag created;
+  std::call_once(created, [] {
+    const char *name = std::getenv("UNSTICKYMEM_NUMA");
+    backend = NumaBackend::getBackend(name != nullptr ? name : "linux");
+  });
+  return *backend;
+}
+
+}  // namespace unstickymem
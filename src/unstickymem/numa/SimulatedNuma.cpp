@@ -0,0 +1,270 @@
+#include <errno.h>
+
+#include <numa.h>
+#include <numaif.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#include "unstickymem/numa/SimulatedNuma.hpp"
+#include "unstickymem/unstickymem.h"
+
+namespace unstickymem {
+
+static NumaBackend::Registrar<SimulatedNuma> registrar(
+    SimulatedNuma::name(), SimulatedNuma::description());
+
+// time the workload computes between two memory accesses
+static const double COMPUTE_NS = 100;
+// queues never quite fill up
+static const double MAX_UTILIZATION = 0.95;
+
+static double env_double(const char *name, double fallback) {
+  const char *value = std::getenv(name);
+  return value != nullptr ? std::atof(value) : fallback;
+}
+
+// a comma-separated list of one value per node, or a single value for all
+static std::vector<double> env_list(const char *name, int nodes) {
+  std::vector<double> values;
+  const char *value = std::getenv(name);
+  if (value == nullptr) {
+    return values;
+  }
+  std::stringstream list(value);
+  std::string item;
+  while (std::getline(list, item, ',')) {
+    values.push_back(std::atof(item.c_str()));
+  }
+  DIEIF(values.size() != 1 && values.size() != static_cast<size_t>(nodes),
+        "simulated node lists need one value, or one per node");
+  values.resize(nodes, values.front());
+  return values;
+}
+
+SimulatedNuma::SimulatedNuma()
+    : _random(env_double("UNSTICKYMEM_SIM_SEED", 1)) {
+  _nodes = env_double("UNSTICKYMEM_SIM_NODES", DEFAULT_SIM_NODES);
+  DIEIF(_nodes <= 0 || _nodes > numa_num_possible_nodes(),
+        "invalid number of simulated nodes");
+  _bandwidth = env_list("UNSTICKYMEM_SIM_BANDWIDTH", _nodes);
+  if (_bandwidth.empty()) {
+    _bandwidth.assign(_nodes, DEFAULT_SIM_BANDWIDTH);
+  } else {
+    // given in GB/s
+    for (double &b : _bandwidth) {
+      b *= 1e9;
+    }
+  }
+  _latency = env_list("UNSTICKYMEM_SIM_LATENCY", _nodes);
+  if (_latency.empty()) {
+    _latency.assign(_nodes, DEFAULT_SIM_REMOTE_LATENCY);
+    _latency[0] = DEFAULT_SIM_LOCAL_LATENCY;
+  }
+  _demand = env_double("UNSTICKYMEM_SIM_DEMAND", DEFAULT_SIM_DEMAND / 1e9)
+      * 1e9;
+  _noise = env_double("UNSTICKYMEM_SIM_NOISE", DEFAULT_SIM_NOISE);
+  for (int node = 0; node < _nodes; node++) {
+    DIEIF(_bandwidth[node] <= 0 || _latency[node] <= 0,
+          "simulated nodes need a positive bandwidth and latency");
+  }
+  _node_pages.assign(_nodes, 0);
+  LINFOF("Simulating %d nodes, the workload reads %.1lf GB/s", _nodes,
+         _demand / 1e9);
+}
+
+int SimulatedNuma::configuredNodes() {
+  return _nodes;
+}
+
+int SimulatedNuma::maxNode() {
+  return _nodes - 1;
+}
+
+bool SimulatedNuma::nodeExists(int node) {
+  return node >= 0 && node < _nodes;
+}
+
+int SimulatedNuma::nodeOfCpu(int cpu) {
+  // every cpu we have is on the first node
+  return cpu >= 0 ? 0 : -1;
+}
+
+int SimulatedNuma::distance(int from, int to) {
+  if (!nodeExists(from) || !nodeExists(to)) {
+    return 0;
+  }
+  if (from == to) {
+    return 10;
+  }
+  // the latencies are seen from the workers, scale them like SLIT does
+  double fastest = *std::min_element(_latency.begin(), _latency.end());
+  return std::lround(10 * std::max(_latency[from], _latency[to]) / fastest);
+}
+
+bool SimulatedNuma::hasMemory(int node) {
+  return nodeExists(node);
+}
+
+struct bitmask *SimulatedNuma::runNodes() {
+  struct bitmask *nodes = numa_allocate_nodemask();
+  numa_bitmask_setbit(nodes, 0);
+  return nodes;
+}
+
+struct bitmask *SimulatedNuma::parseNodes(const char *list) {
+  // libnuma only accepts the nodes it knows about
+  struct bitmask *nodes = numa_parse_nodestring_all(list);
+  if (nodes == nullptr) {
+    return nullptr;
+  }
+  for (unsigned int node = _nodes; node < nodes->size; node++) {
+    if (numa_bitmask_isbitset(nodes, node)) {
+      numa_bitmask_free(nodes);
+      return nullptr;
+    }
+  }
+  return nodes;
+}
+
+void SimulatedNuma::setNode(uintptr_t page, int node) {
+  auto [it, added] = _pages.emplace(page, node);
+  if (!added) {
+    _node_pages[it->second]--;
+    it->second = node;
+  }
+  _node_pages[node]++;
+}
+
+long SimulatedNuma::bind(void *addr, unsigned long len, int mode,
+                         const unsigned long *nodemask, unsigned long maxnode,
+                         unsigned flags) {
+  std::vector<int> nodes;
+  for (unsigned long node = 0; node < maxnode && node < (unsigned) _nodes;
+      node++) {
+    if (nodemask[node / (8 * sizeof(long))] >> (node % (8 * sizeof(long)))
+        & 1) {
+      nodes.push_back(node);
+    }
+  }
+  if (nodes.empty() && mode != MPOL_DEFAULT && mode != MPOL_LOCAL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (!(flags & MPOL_MF_MOVE)) {
+    return 0;
+  }
+
+  // interleaved pages go round robin by page number like the kernel's
+  // (anonymous mappings start at their address), anything else to the
+  // first node
+  std::scoped_lock lock(_lock);
+  uintptr_t first = reinterpret_cast<uintptr_t>(addr) / numa_pagesize();
+  uintptr_t count = len / numa_pagesize();
+  for (uintptr_t i = 0; i < count; i++) {
+    int node = nodes.empty() ? 0 : mode == MPOL_INTERLEAVE ?
+        nodes[(first + i) % nodes.size()] : nodes.front();
+    setNode(first + i, node);
+  }
+  return 0;
+}
+
+long SimulatedNuma::movePages(unsigned long count, void **pages,
+                              const int *nodes, int *status, int flags) {
+  std::scoped_lock lock(_lock);
+  for (unsigned long i = 0; i < count; i++) {
+    uintptr_t page = reinterpret_cast<uintptr_t>(pages[i]) / numa_pagesize();
+    if (nodes == nullptr) {
+      auto it = _pages.find(page);
+      status[i] = it == _pages.end() ? -ENOENT : it->second;
+    } else if (!nodeExists(nodes[i])) {
+      status[i] = -ENODEV;
+    } else if (_failures > 0) {
+      _failures--;
+      status[i] = -_failure_error;
+    } else {
+      setNode(page, nodes[i]);
+      status[i] = nodes[i];
+    }
+  }
+  return 0;
+}
+
+void SimulatedNuma::failMoves(size_t count, int error) {
+  std::scoped_lock lock(_lock);
+  _failures = count;
+  _failure_error = error;
+}
+
+int SimulatedNuma::nodeOf(void *page) {
+  std::scoped_lock lock(_lock);
+  auto it = _pages.find(reinterpret_cast<uintptr_t>(page) / numa_pagesize());
+  return it == _pages.end() ? -ENOENT : it->second;
+}
+
+bool SimulatedNuma::nodeBandwidth(std::vector<double> *bandwidth) {
+  *bandwidth = _bandwidth;
+  return true;
+}
+
+void SimulatedNuma::unmapped(void *addr, size_t len) {
+  std::scoped_lock lock(_lock);
+  uintptr_t first = reinterpret_cast<uintptr_t>(addr) / numa_pagesize();
+  uintptr_t count = (len + numa_pagesize() - 1) / numa_pagesize();
+  for (uintptr_t page = first; page < first + count; page++) {
+    auto it = _pages.find(page);
+    if (it != _pages.end()) {
+      _node_pages[it->second]--;
+      _pages.erase(it);
+    }
+  }
+}
+
+std::vector<double> SimulatedNuma::pageShares() {
+  std::scoped_lock lock(_lock);
+  std::vector<double> shares(_nodes, 0);
+  if (_pages.empty()) {
+    // nothing placed yet, the memory is local
+    shares[0] = 1;
+    return shares;
+  }
+  for (int node = 0; node < _nodes; node++) {
+    shares[node] = static_cast<double>(_node_pages[node]) / _pages.size();
+  }
+  return shares;
+}
+
+std::vector<double> SimulatedNuma::modelTraffic(
+    const std::vector<double> &shares) const {
+  std::vector<double> traffic(_nodes, 0);
+  for (int node = 0; node < _nodes; node++) {
+    traffic[node] = std::min(_demand * shares[node],
+                             _bandwidth[node] * MAX_UTILIZATION);
+  }
+  return traffic;
+}
+
+double SimulatedNuma::modelStallRate(const std::vector<double> &shares) const {
+  // each node is a queue: its latency grows with its utilization
+  double latency = 0;
+  for (int node = 0; node < _nodes; node++) {
+    double utilization = std::min(_demand * shares[node] / _bandwidth[node],
+                                  MAX_UTILIZATION);
+    latency += shares[node] * _latency[node] / (1 - utilization);
+  }
+  return latency / (latency + COMPUTE_NS);
+}
+
+double SimulatedNuma::stallRate() {
+  double rate = modelStallRate(pageShares());
+  if (_noise <= 0) {
+    return rate;
+  }
+  std::scoped_lock lock(_lock);
+  std::normal_distribution<double> noise(0, _noise);
+  return std::max(rate * (1 + noise(_random)), 0.0);
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "unstickymem/search/BayesianSearch.hpp"
+
+namespace unstickymem {
+
+static SearchStrategy::Registrar<BayesianSearch> registrar(
+    BayesianSearch::name(), BayesianSearch::description());
+
+// correlation length of the kernel, relative to the searched interval
+static const double LENGTH_SCALE = 0.25;
+// expected improvement (in standard deviations of the measurements) below
+// which another evaluation is not worth a migration
+static const double MIN_EXPECTED_IMPROVEMENT = 0.01;
+
+struct Observation {
+  double ratio;
+  double rate;
+  double noise;  // variance of the measured mean
+};
+
+// Gaussian process regression over the normalized observations, with a
+// squared exponential kernel of unit variance
+class GaussianProcess {
+ private:
+  std::vector<Observation> _obs;
+  double _length;
+  double _offset = 0;
+  double _scale = 1;
+  std::vector<double> _chol;   // lower triangular factor of the covariance
+  std::vector<double> _alpha;  // covariance^-1 * normalized rates
+
+  double kernel(double x, double y) const {
+    double d = (x - y) / _length;
+    return std::exp(-0.5 * d * d);
+  }
+
+  // solves L x = b in place
+  void forwardSubstitute(std::vector<double> *b) const {
+    size_t n = _obs.size();
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < i; j++) {
+        (*b)[i] -= _chol[i * n + j] * (*b)[j];
+      }
+      (*b)[i] /= _chol[i * n + i];
+    }
+  }
+
+ public:
+  GaussianProcess(const std::vector<Observation> &obs, double length)
+      : _obs(obs),
+        _length(length) {
+    size_t n = _obs.size();
+    double sum = 0, sq = 0;
+    for (auto &o : _obs) {
+      sum += o.rate;
+      sq += o.rate * o.rate;
+    }
+    _offset = sum / n;
+    double variance = sq / n - _offset * _offset;
+    _scale = variance > 0 ? std::sqrt(variance) : std::fabs(_offset) + 1e-12;
+
+    // Cholesky factorization of the covariance plus measurement noise
+    _chol.assign(n * n, 0);
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j <= i; j++) {
+        double v = kernel(_obs[i].ratio, _obs[j].ratio);
+        if (i == j) {
+          v += _obs[i].noise / (_scale * _scale) + 1e-6;
+        }
+        for (size_t k = 0; k < j; k++) {
+          v -= _chol[i * n + k] * _chol[j * n + k];
+        }
+        _chol[i * n + j] = i == j ? std::sqrt(std::max(v, 1e-12)) :
+            v / _chol[j * n + j];
+      }
+    }
+
+    // alpha = L^-T L^-1 y
+    _alpha.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      _alpha[i] = normalize(_obs[i].rate);
+    }
+    forwardSubstitute(&_alpha);
+    for (size_t i = n; i-- > 0;) {
+      for (size_t j = i + 1; j < n; j++) {
+        _alpha[i] -= _chol[j * n + i] * _alpha[j];
+      }
+      _alpha[i] /= _chol[i * n + i];
+    }
+  }
+
+  double normalize(double rate) const {
+    return (rate - _offset) / _scale;
+  }
+
+  // normalized posterior mean and variance at ratio x
+  void predict(double x, double *mean, double *variance) const {
+    size_t n = _obs.size();
+    std::vector<double> k(n);
+    for (size_t i = 0; i < n; i++) {
+      k[i] = kernel(x, _obs[i].ratio);
+    }
+    *mean = 0;
+    for (size_t i = 0; i < n; i++) {
+      *mean += k[i] * _alpha[i];
+    }
+    forwardSubstitute(&k);
+    *variance = 1;
+    for (size_t i = 0; i < n; i++) {
+      *variance -= k[i] * k[i];
+    }
+    *variance = std::max(*variance, 0.0);
+  }
+};
+
+// expected amount by which a point with that posterior undercuts best
+static double expected_improvement(double mean, double variance,
+                                   double best) {
+  double sigma = std::sqrt(variance);
+  if (sigma < 1e-9) {
+    return std::max(best - mean, 0.0);
+  }
+  double z = (best - mean) / sigma;
+  double cdf = 0.5 * std::erfc(-z / std::sqrt(2.0));
+  double pdf = std::exp(-0.5 * z * z) / std::sqrt(2 * M_PI);
+  return (best - mean) * cdf + sigma * pdf;
+}
+
+double BayesianSearch::search(RatioEvaluator &evaluator,
+                              const SearchSpace &space) {
+  std::vector<Observation> obs;
+  auto observe = [&](double ratio) {
+    StallStats stats = evaluator.evaluate(ratio, 1.0);
+    double noise = stats.count > 1 ? stats.variance / stats.count : 0;
+    obs.push_back({ ratio, stats.mean, noise });
+  };
+
+  // both ends and the middle before trusting the model
+  observe(space.low);
+  observe(space.high);
+  observe((space.low + space.high) / 2);
+
+  double length = LENGTH_SCALE * (space.high - space.low);
+  while (obs.size() < space.max_steps) {
+    GaussianProcess gp(obs, length);
+    double best = INFINITY;
+    for (auto &o : obs) {
+      best = std::min(best, gp.normalize(o.rate));
+    }
+
+    // the candidates are the ratios on the resolution grid, those within
+    // half a step of a tested ratio cannot be told apart from it
+    double next = NAN;
+    double next_ei = 0;
+    for (double x = space.low; x <= space.high + 1e-9;
+        x += space.resolution) {
+      bool tested = std::any_of(obs.begin(), obs.end(), [&](auto &o) {
+        return std::fabs(o.ratio - x) < space.resolution / 2;
+      });
+      if (tested) {
+        continue;
+      }
+      double mean, variance;
+      gp.predict(x, &mean, &variance);
+      double ei = expected_improvement(mean, variance, best);
+      if (ei > next_ei) {
+        next = x;
+        next_ei = ei;
+      }
+    }
+    if (std::isnan(next) || next_ei < MIN_EXPECTED_IMPROVEMENT) {
+      break;
+    }
+    LDEBUGF("expected improvement %1.4lf at %1.2lf", next_ei, next);
+    observe(std::min(next, space.high));
+  }
+
+  // the tested ratio the model believes to be lowest
+  GaussianProcess gp(obs, length);
+  double best_ratio = obs.front().ratio;
+  double best_mean = INFINITY;
+  for (auto &o : obs) {
+    double mean, variance;
+    gp.predict(o.ratio, &mean, &variance);
+    if (mean < best_mean) {
+      best_mean = mean;
+      best_ratio = o.ratio;
+    }
+  }
+  return best_ratio;
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,59 @@
+#include <cmath>
+
+#include "unstickymem/search/GoldenSectionSearch.hpp"
+
+namespace unstickymem {
+
+static SearchStrategy::Registrar<GoldenSectionSearch> registrar(
+    GoldenSectionSearch::name(), GoldenSectionSearch::description());
+
+// whether the ratio placed last measured lower than the other one, falling
+// back to the means when the difference is within the noise
+static bool measured_lower(RatioEvaluator &evaluator, StallStats *current,
+                           const StallStats &other) {
+  StallComparison verdict = evaluator.compare(current, other);
+  if (verdict == StallComparison::UNDECIDED) {
+    return current->mean < other.mean;
+  }
+  return verdict == StallComparison::LOWER;
+}
+
+double GoldenSectionSearch::search(RatioEvaluator &evaluator,
+                                   const SearchSpace &space) {
+  const double invphi = (std::sqrt(5.0) - 1) / 2;
+  double a = space.low;
+  double b = space.high;
+
+  // two inner points, each iteration reuses one of them
+  double c = b - invphi * (b - a);
+  double d = a + invphi * (b - a);
+  StallStats fc = evaluator.evaluate(c, 1.0);
+  StallStats fd = evaluator.evaluate(d, 1.0);
+  bool d_lower = measured_lower(evaluator, &fd, fc);
+  unsigned int steps = 2;
+
+  while (b - a > space.resolution && steps < space.max_steps) {
+    if (d_lower) {
+      // the minimum is in [c, b]
+      a = c;
+      c = d;
+      fc = fd;
+      d = a + invphi * (b - a);
+      fd = evaluator.evaluate(d, 1.0);
+      d_lower = measured_lower(evaluator, &fd, fc);
+    } else {
+      // the minimum is in [a, d]
+      b = d;
+      d = c;
+      fd = fc;
+      c = b - invphi * (b - a);
+      fc = evaluator.evaluate(c, 1.0);
+      d_lower = !measured_lower(evaluator, &fc, fd);
+    }
+    steps++;
+  }
+  LDEBUGF("golden-section search narrowed down to [%1.2lf, %1.2lf]", a, b);
+  return d_lower ? d : c;
+}
+
+}  // namespace unstickymem
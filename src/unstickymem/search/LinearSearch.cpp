@@ -0,0 +1,41 @@
+#include <algorithm>
+#include <cmath>
+
+#include "unstickymem/search/LinearSearch.hpp"
+
+namespace unstickymem {
+
+static SearchStrategy::Registrar<LinearSearch> registrar(
+    LinearSearch::name(), LinearSearch::description());
+
+double LinearSearch::search(RatioEvaluator &evaluator,
+                            const SearchSpace &space) {
+  StallStats best;
+  double best_ratio = space.low;
+
+  // the last step is cut short to end on the high ratio
+  int steps = std::ceil((space.high - space.low) / space.resolution - 1e-9);
+  for (int i = 0; i <= steps; i++) {
+    double ratio = std::min(space.low + i * space.resolution, space.high);
+    StallStats stats = evaluator.evaluate(ratio, 1.0);
+    if (best.count == 0) {
+      best = stats;
+      best_ratio = ratio;
+      continue;
+    }
+
+    StallComparison verdict = evaluator.compare(&stats, best);
+    if (verdict == StallComparison::LOWER) {
+      best = stats;
+      best_ratio = ratio;
+    } else if (verdict == StallComparison::HIGHER) {
+      LINFOF("%1.2lf is significantly worse than %1.2lf, stopping", ratio,
+             best_ratio);
+      break;
+    }
+    // undecided: no measurable difference, keep walking
+  }
+  return best_ratio;
+}
+
+}  // namespace unstickymem
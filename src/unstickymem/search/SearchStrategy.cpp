@@ -0,0 +1,10 @@
+#include "unstickymem/search/SearchStrategy.hpp"
+
+namespace unstickymem {
+
+std::map<std::string, SearchStrategy::Description> & SearchStrategy::registry() {
+  static std::map<std::string, SearchStrategy::Description> r;
+  return r;
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,46 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "unstickymem/search/SuccessiveHalvingSearch.hpp"
+
+namespace unstickymem {
+
+static SearchStrategy::Registrar<SuccessiveHalvingSearch> registrar(
+    SuccessiveHalvingSearch::name(), SuccessiveHalvingSearch::description());
+
+// most ratios measured in the first round
+static const size_t MAX_CANDIDATES = 8;
+
+double SuccessiveHalvingSearch::search(RatioEvaluator &evaluator,
+                                       const SearchSpace &space) {
+  size_t count = std::floor((space.high - space.low) / space.resolution + 1e-9)
+      + 1;
+  count = std::clamp<size_t>(count, 2, MAX_CANDIDATES);
+  std::vector<double> candidates;
+  for (size_t i = 0; i < count; i++) {
+    candidates.push_back(
+        space.low + (space.high - space.low) * i / (count - 1));
+  }
+
+  // the last round measures full windows
+  size_t rounds = std::ceil(std::log2(count));
+  double effort = std::ldexp(1.0, -static_cast<int>(rounds - 1));
+
+  while (candidates.size() > 1) {
+    std::vector<std::pair<double, double>> results;
+    for (double ratio : candidates) {
+      StallStats stats = evaluator.evaluate(ratio, effort);
+      results.push_back({ stats.trimmed_mean, ratio });
+    }
+    std::sort(results.begin(), results.end());
+    candidates.clear();
+    for (size_t i = 0; i < (results.size() + 1) / 2; i++) {
+      candidates.push_back(results[i].second);
+    }
+    effort = std::min(effort * 2, 1.0);
+  }
+  return candidates.front();
+}
+
+}  // namespace unstickymem
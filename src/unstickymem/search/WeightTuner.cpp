@@ -0,0 +1,127 @@
+#include <numa.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <string>
+
+#include "unstickymem/search/WeightTuner.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
+
+namespace unstickymem {
+
+static std::string weights_string(const std::vector<double> &weights) {
+  std::string s;
+  for (size_t node = 0; node < weights.size(); node++) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s%zu:%.1lf", s.empty() ? "" : " ", node,
+             weights[node]);
+    s += buf;
+  }
+  return s;
+}
+
+WeightTuner::WeightTuner(const WeightTunerParameters &parameters)
+    : _parameters(parameters) {
+  DIEIF(_parameters.min_step <= 0 || _parameters.step < _parameters.min_step,
+        "the weight tuner steps must satisfy 0 < min step <= step");
+  // nodes without memory (or outside our cpuset) cannot receive pages
+  for (int node = 0; node <= numa().maxNode(); node++) {
+    _tunable.push_back(numa().nodeExists(node) && numa().hasMemory(node));
+  }
+}
+
+std::vector<double> WeightTuner::normalize(std::vector<double> weights) const {
+  weights.resize(_tunable.size(), 0);
+  for (size_t node = 0; node < weights.size(); node++) {
+    if (!_tunable[node] || weights[node] < 0) {
+      weights[node] = 0;
+    }
+  }
+  double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+  if (sum <= 0) {
+    // nothing left, fall back to uniform interleaving
+    for (size_t node = 0; node < weights.size(); node++) {
+      weights[node] = _tunable[node];
+    }
+    sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+  }
+  for (auto &w : weights) {
+    w = w / sum * 100;
+  }
+  return weights;
+}
+
+std::vector<double> WeightTuner::tune(WeightEvaluator &evaluator,
+                                      std::vector<double> weights) {
+  weights = normalize(weights);
+  StallStats current = evaluator.evaluate(weights);
+  std::vector<double> placed = weights;
+  double step = _parameters.step;
+
+  for (unsigned int iteration = 0; iteration < _parameters.max_iterations
+      && step >= _parameters.min_step; iteration++) {
+    LINFOF("weight tuning iteration %u: [%s] stall rate %1.10lf (step %.1lf)",
+           iteration, weights_string(weights).c_str(), current.mean, step);
+
+    // forward differences: relative change of the stall rate per weight
+    // point given to each node (taken proportionally from the others).
+    // relative to its magnitude, the progress objective is negative
+    double scale = current.mean != 0 ? std::fabs(current.mean) : 1;
+    std::vector<double> gradient(weights.size(), 0);
+    for (size_t node = 0; node < weights.size(); node++) {
+      if (!_tunable[node]) {
+        continue;
+      }
+      std::vector<double> probe = weights;
+      probe[node] += step;
+      probe = normalize(probe);
+      double delta = probe[node] - weights[node];
+      if (delta <= 0) {
+        continue;  // the node already holds everything
+      }
+      StallStats stats = evaluator.evaluate(probe);
+      placed = probe;
+      gradient[node] = (stats.mean - current.mean) / scale / delta;
+      LDEBUGF("node %zu: %+1.4lf%% stall rate per weight point", node,
+              gradient[node] * 100);
+    }
+
+    // step against the gradient, its largest component moves `step` points
+    double largest = 0;
+    for (double g : gradient) {
+      largest = std::max(largest, std::fabs(g));
+    }
+    if (largest == 0 || !std::isfinite(largest)) {
+      LINFO("the stall rate does not depend on the weights");
+      break;
+    }
+    std::vector<double> next = weights;
+    for (size_t node = 0; node < next.size(); node++) {
+      next[node] -= step * gradient[node] / largest;
+    }
+    next = normalize(next);
+
+    StallStats stats = evaluator.evaluate(next);
+    placed = next;
+    StallComparison verdict = evaluator.compare(&stats, current);
+    if (verdict == StallComparison::LOWER
+        || (verdict == StallComparison::UNDECIDED
+            && stats.mean < current.mean)) {
+      weights = next;
+      current = stats;
+    } else {
+      step /= 2;
+    }
+  }
+
+  LINFOF("tuned weights: [%s] stall rate %1.10lf",
+         weights_string(weights).c_str(), current.mean);
+  if (placed != weights) {
+    evaluator.place(weights);
+  }
+  return weights;
+}
+
+}  // namespace unstickymem
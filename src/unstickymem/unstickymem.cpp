@@ -1,5 +1,6 @@
 #include <unistd.h>
 #include <dlfcn.h>
+#include <malloc.h>
 #include <sys/types.h>
 #include <sys/syscall.h>
 
@@ -15,22 +16,28 @@
 #include <boost/interprocess/shared_memory_object.hpp>
 
 #include "unstickymem/unstickymem.h"
+#include "unstickymem/BandwidthProbe.hpp"
 #include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/PlacementCache.hpp"
 #include "unstickymem/PagePlacement.hpp"
 #include "unstickymem/Logger.hpp"
 #include "unstickymem/wrap.hpp"
 #include "unstickymem/Runtime.hpp"
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/mode/Mode.hpp"
+#include "unstickymem/numa/NumaBackend.hpp"
 
+// number of NUMA nodes in the system
+int NUM_NODES = 0;
 // hold the nodes information ids and weights
-RECORD nodes_info[MAX_NODES];
+RECORD *nodes_info = nullptr;
 // sum of worker nodes weights
 double sum_ww = 0;
 // sum of non-worker nodes weights
 double sum_nww = 0;
-// number of workers
+// the worker nodes (given explicitly or derived from the CPU affinity)
 static bool OPT_NUM_WORKERS = false;
+struct bitmask *WORKER_NODES = nullptr;
 static bool WEIGHTS = false;
 bool MONITORING_CORE = false;
 static bool PMC = false;
@@ -47,19 +54,100 @@ thread_local static bool inside_unstickymem = false;
 Runtime *runtime;
 MemoryMap *memory;
 
+// comma-separated list of the worker nodes, for logging
+std::string worker_nodes_string(void) {
+  std::string result;
+  for (int i = 0; i < NUM_NODES; i++) {
+    if (is_worker_node(nodes_info[i].id)) {
+      result += (result.empty() ? "" : ",") + std::to_string(nodes_info[i].id);
+    }
+  }
+  return result;
+}
+
+// size the node table from the topology of the machine we are running on
+void init_nodes_info(void) {
+  NUM_NODES = unstickymem::numa().configuredNodes();
+  DIEIF(NUM_NODES <= 0, "could not determine the number of NUMA nodes");
+  nodes_info = reinterpret_cast<RECORD*>(WRAP(calloc)(NUM_NODES,
+                                                      sizeof(RECORD)));
+  DIEIF(nodes_info == nullptr, "error allocating the nodes table");
+
+  // every node starts with no weight, in the order the kernel reports them
+  int j = 0;
+  for (int node = 0; node <= unstickymem::numa().maxNode() && j < NUM_NODES;
+      node++) {
+    if (unstickymem::numa().nodeExists(node)) {
+      nodes_info[j].id = node;
+      nodes_info[j].weight = 0;
+      nodes_info[j].count = 0;
+      j++;
+    }
+  }
+}
+
+// the placement functions expect the nodes sorted by increasing weight
+void sort_node_weights(void) {
+  std::stable_sort(nodes_info, nodes_info + NUM_NODES,
+                   [](const RECORD &a, const RECORD &b) {
+                     return a.weight < b.weight;
+                   });
+
+  int i;
+  printf("Initial Weights:\t");
+  for (i = 0; i < NUM_NODES; i++) {
+    printf("id: %d w: %.1f\t", nodes_info[i].id, nodes_info[i].weight);
+  }
+  printf("\n");
+
+  node_weights_changed();
+  LINFO("weights initialized!");
+}
+
+// weights indexed by node id
+void set_node_weights(const std::vector<double> &weights) {
+  for (int i = 0; i < NUM_NODES; i++) {
+    int id = nodes_info[i].id;
+    nodes_info[i].weight = id < static_cast<int>(weights.size()) ?
+        weights[id] : 0;
+  }
+  sort_node_weights();
+}
+
 void read_config(void) {
+  init_nodes_info();
+
+  // worker nodes: a node list (e.g. "0,2-3") or the nodes we may run on
   OPT_NUM_WORKERS = std::getenv("UNSTICKYMEM_WORKERS") != nullptr;
   if (OPT_NUM_WORKERS) {
-    OPT_NUM_WORKERS_VALUE = std::stoi(std::getenv("UNSTICKYMEM_WORKERS"));
+    WORKER_NODES = unstickymem::numa().parseNodes(
+        std::getenv("UNSTICKYMEM_WORKERS"));
+    DIEIF(WORKER_NODES == nullptr,
+          "UNSTICKYMEM_WORKERS must be a node list, e.g. 0,2-3");
+  } else {
+    WORKER_NODES = unstickymem::numa().runNodes();
   }
+  OPT_NUM_WORKERS_VALUE = numa_bitmask_weight(WORKER_NODES);
+  DIEIF(OPT_NUM_WORKERS_VALUE == 0, "there must be at least one worker node");
 
   WEIGHTS = std::getenv("BWAP_WEIGHTS") != nullptr;
   if (WEIGHTS) {
     char* weights = std::getenv("BWAP_WEIGHTS");
     read_weights(weights);
   } else {
-    LDEBUG("Sorry, Weights have not been provided!");
-    exit (EXIT_FAILURE);
+    // the bandwidth only depends on the machine, measure it once
+    unstickymem::CachedPlacement calibration;
+    std::string key = unstickymem::topology_key();
+    if (unstickymem::load_cached_placement(key, &calibration)
+        && calibration.weights.size() == static_cast<size_t>(NUM_NODES)) {
+      LINFO("BWAP_WEIGHTS not set, using the cached node weights");
+    } else {
+      LINFO("BWAP_WEIGHTS not set, deriving the weights from the bandwidth "
+            "of each node");
+      calibration.weights = bandwidth_weights(measure_node_bandwidth());
+      unstickymem::store_cached_placement(key, calibration);
+    }
+    set_node_weights(calibration.weights);
   }
 
   MONITORING_CORE = std::getenv("BWAP_CORE") != nullptr;
@@ -74,8 +162,8 @@ void read_config(void) {
 }
 
 void print_config(void) {
-  LINFOF("num_workers: %s",
-         OPT_NUM_WORKERS ? std::to_string(OPT_NUM_WORKERS_VALUE).c_str() : "no");
+  LINFOF("worker_nodes: %s (%s)", worker_nodes_string().c_str(),
+         OPT_NUM_WORKERS ? "UNSTICKYMEM_WORKERS" : "cpu affinity");
   LINFOF("monitoring_core: %s",
          MONITORING_CORE ? std::to_string(MONITORING_CORE_VALUE).c_str() : "no");
 }
@@ -91,11 +179,11 @@ __attribute__((constructor)) void libunstickymem_initialize(void) {
   read_config();
   //print_config();
 
-  // initialize likwid
-  //initialize_likwid();
+  // initialize the performance counters
+  //initialize_counters();
 
   //set sum_ww & sum_nww & initialize the weights!
-  //get_sum_nww_ww(OPT_NUM_WORKERS_VALUE);
+  //get_sum_nww_ww();
 
   // set default memory policy to interleaved
   /*LDEBUG("Setting default memory policy to interleaved");
@@ -134,11 +222,11 @@ __attribute((destructor)) void libunstickymem_finalize(void) {
 extern "C" {
 #endif
 
-int check_sum(RECORD n_i[MAX_NODES]) {
+int check_sum(RECORD *n_i) {
   double sum = 0;
   int i = 0;
 
-  for (i = 0; i < MAX_NODES; i++) {
+  for (i = 0; i < NUM_NODES; i++) {
     sum += n_i[i].weight;
   }
   return std::lround(sum);
@@ -175,18 +263,6 @@ void read_weights(char filename[]) {
   const char s[2] = " ";
   char *token;
 
-  int retcode;
-  // First sort the file if not sorted
-  char cmdbuf[256];
-  snprintf(cmdbuf, sizeof(cmdbuf), "sort -n -o %s %s", filename, filename);
-  retcode = system(cmdbuf);
-  if (retcode == -1) {
-    printf("Unable to sort the weights!");
-    exit (EXIT_FAILURE);
-  }
-
-  int j = 0;
-
   fp = fopen(filename, "r");
   if (fp == NULL) {
     printf("Weights have not been provided, empty file or wrong file name!\n");
@@ -200,123 +276,52 @@ void read_weights(char filename[]) {
 
     // get the first token
     token = strtok_r(line, s, &strtok_saveptr);
-    nodes_info[j].weight = atof(token);
+    if (token == NULL || *token == '\n') {
+      continue;
+    }
+    float weight = atof(token);
     // printf(" %s\n", token);
 
     // get the second token
     token = strtok_r(NULL, s, &strtok_saveptr);
-    nodes_info[j].id = atoi(token);
+    DIEIF(token == NULL, "weights file lines must be '<weight> <node id>'");
+    int id = atoi(token);
     // printf(" %s\n", token);
-    j++;
-  }
 
-  int i;
-  printf("Initial Weights:\t");
-  for (i = 0; i < MAX_NODES; i++) {
-    printf("id: %d w: %.1f\t", nodes_info[i].id, nodes_info[i].weight);
+    // nodes that are not in the file keep a weight of zero
+    RECORD *node = std::find_if(nodes_info, nodes_info + NUM_NODES,
+                                [id](const RECORD &r) {return r.id == id;});
+    if (node == nodes_info + NUM_NODES) {
+      LWARNF("Ignoring weight for node %d, which is not in this system", id);
+      continue;
+    }
+    node->weight = weight;
   }
-  printf("\n");
 
   fclose(fp);
   if (line)
     free(line);
 
-  LINFO("weights initialized!");
+  unstickymem::sort_node_weights();
+}
 
-  return;
+int is_worker_node(int node) {
+  return numa_bitmask_isbitset(WORKER_NODES, node);
 }
 
-void get_sum_nww_ww(int num_workers) {
+void get_sum_nww_ww(void) {
   int i;
 
-  if (num_workers == 1) {
-    //workers: 0
-    //printf("Worker Nodes:\t");
-    LDEBUG("Worker Nodes: 0");
-    for (i = 0; i < MAX_NODES; i++) {
-      if (nodes_info[i].id == 0) {
-        //printf("nodes_info[%d].id=%d", i, nodes_info[i].id);
-        sum_ww += nodes_info[i].weight;
-      } else {
-        sum_nww += nodes_info[i].weight;
-      }
-    }
-  } else if (num_workers == 2) {
-    //workers: 1
-    //printf("Worker Nodes:\t");
-    LDEBUG("Worker Nodes: 1");
-    for (i = 0; i < MAX_NODES; i++) {
-      if (nodes_info[i].id == 1) {
-        //printf("nodes_info[%d].id=%d", i, nodes_info[i].id);
-        sum_ww += nodes_info[i].weight;
-      } else {
-        sum_nww += nodes_info[i].weight;
-      }
+  sum_ww = 0;
+  sum_nww = 0;
+  LDEBUGF("Worker Nodes: %s", unstickymem::worker_nodes_string().c_str());
+  for (i = 0; i < NUM_NODES; i++) {
+    if (is_worker_node(nodes_info[i].id)) {
+      sum_ww += nodes_info[i].weight;
+    } else {
+      sum_nww += nodes_info[i].weight;
     }
   }
-  /*else if (num_workers == 2) {
-   //workers: 0,1
-   char weights[] = "/home/dgureya/devs/unstickymem/config/weights_2w.txt";
-   read_weights(weights);
-   //printf("Worker Nodes:\t");
-   LDEBUG("Worker Nodes: 0,1");
-   for (i = 0; i < MAX_NODES; i++) {
-   if (nodes_info[i].id == 0 || nodes_info[i].id == 1) {
-   //printf("nodes_info[%d].id=%d\t", i, nodes_info[i].id);
-   sum_ww += nodes_info[i].weight;
-   } else {
-   sum_nww += nodes_info[i].weight;
-   }
-   }
-   } else if (num_workers == 3) {
-   //workers: 1,2,3
-   char weights[] = "/home/dgureya/devs/unstickymem/config/weights_3w.txt";
-   read_weights(weights);
-   //printf("Worker Nodes:\t");
-   LDEBUG("Worker Nodes: 1,2,3");
-   for (i = 0; i < MAX_NODES; i++) {
-   if (nodes_info[i].id == 1 || nodes_info[i].id == 2
-   || nodes_info[i].id == 3) {
-   //printf("nodes_info[%d].id=%d\t", i, nodes_info[i].id);
-   sum_ww += nodes_info[i].weight;
-   } else {
-   sum_nww += nodes_info[i].weight;
-   }
-   }
-   } else if (num_workers == 4) {
-   //workers: 0,1,2,3
-   char weights[] = "/home/dgureya/devs/unstickymem/config/weights_4w.txt";
-   read_weights(weights);
-   //printf("Worker Nodes:\t");
-   LDEBUG("Worker Nodes: 0,1,2,3");
-   for (i = 0; i < MAX_NODES; i++) {
-   if (nodes_info[i].id == 0 || nodes_info[i].id == 1
-   || nodes_info[i].id == 2 || nodes_info[i].id == 3) {
-   //printf("nodes_info[%d].id=%d\t", i, nodes_info[i].id);
-   sum_ww += nodes_info[i].weight;
-   } else {
-   sum_nww += nodes_info[i].weight;
-   }
-   }
-   } else if (num_workers == 8) {
-   //workers: all
-   char weights[] = "/home/dgureya/devs/unstickymem/config/weights_8w.txt";
-   read_weights(weights);
-   //printf("Worker Nodes:\t");
-   LDEBUG("Worker Nodes: 0,1,2,3");
-   for (i = 0; i < MAX_NODES; i++) {
-   if (nodes_info[i].id == 0 || nodes_info[i].id == 1
-   || nodes_info[i].id == 2 || nodes_info[i].id == 3) {
-   //printf("nodes_info[%d].id=%d\t", i, nodes_info[i].id);
-   sum_ww += nodes_info[i].weight;
-   } else {
-   sum_nww += nodes_info[i].weight;
-   }
-   }
-   } */else {
-    LDEBUGF("Sorry, %d workers is not supported at the moment!", num_workers);
-    exit (EXIT_FAILURE);
-  }
 
   if ((int) round((sum_nww + sum_ww)) != 100) {
     LDEBUGF(
@@ -333,8 +338,16 @@ void get_sum_nww_ww(int num_workers) {
 // Wrapped functions
 
 void *malloc(size_t size) {
+  // small allocations are not tracked, hand them straight to libc
+  if (unstickymem::is_initialized && !unstickymem::MemoryMap::isTracked(size)) {
+    return WRAP(malloc)(size);
+  }
+
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
+    if (WRAP(malloc)) {
+      return WRAP(malloc)(size);
+    }
     return ((void* (*)(size_t)) dlsym(RTLD_NEXT, "malloc"))(size);
   }
 
@@ -364,8 +377,19 @@ void *calloc(size_t nmemb, size_t size) {
     return calloc_buffer;
   }
 
+  // small allocations are not tracked, hand them straight to libc
+  size_t total;
+  if (unstickymem::is_initialized
+      && !__builtin_mul_overflow(nmemb, size, &total)
+      && !unstickymem::MemoryMap::isTracked(total)) {
+    return WRAP(calloc)(nmemb, size);
+  }
+
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
+    if (WRAP(calloc)) {
+      return WRAP(calloc)(nmemb, size);
+    }
     inside_dlsym = true;
     void *result = ((void* (*)(size_t, size_t)) dlsym(RTLD_NEXT, "calloc"))(
         nmemb, size);
@@ -382,8 +406,28 @@ void *calloc(size_t nmemb, size_t size) {
 }
 
 void *realloc(void *ptr, size_t size) {
+  // the buffer handed to dlsym is not libc's, move its contents out
+  if (ptr == calloc_buffer) {
+    void *result = malloc(size);
+    if (result != nullptr) {
+      memcpy(result, calloc_buffer,
+             std::min<size_t>(size, DLSYM_CALLOC_BUFFER_LENGTH));
+      calloc_buffer_in_use = false;
+    }
+    return result;
+  }
+
+  // neither the old nor the new block are tracked
+  if (unstickymem::is_initialized && !unstickymem::MemoryMap::isTracked(size)
+      && !unstickymem::MemoryMap::isTracked(malloc_usable_size(ptr))) {
+    return WRAP(realloc)(ptr, size);
+  }
+
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
+    if (WRAP(realloc)) {
+      return WRAP(realloc)(ptr, size);
+    }
     return ((void *(*)(void*, size_t)) dlsym(RTLD_NEXT, "realloc"))(ptr, size);
   }
 
@@ -415,8 +459,16 @@ void free(void *ptr) {
     calloc_buffer_in_use = false;
     return;
   }
+  // blocks smaller than the threshold were never tracked
+  if (unstickymem::is_initialized
+      && !unstickymem::MemoryMap::isTracked(malloc_usable_size(ptr))) {
+    return WRAP(free)(ptr);
+  }
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
+    if (WRAP(free)) {
+      return WRAP(free)(ptr);
+    }
     return ((void (*)(void*)) dlsym(RTLD_NEXT, "free"))(ptr);
   }
   // handle the function ourselves
@@ -427,6 +479,10 @@ void free(void *ptr) {
 }
 
 int posix_memalign(void **memptr, size_t alignment, size_t size) {
+  // small allocations are not tracked, hand them straight to libc
+  if (unstickymem::is_initialized && !unstickymem::MemoryMap::isTracked(size)) {
+    return WRAP(posix_memalign)(memptr, alignment, size);
+  }
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
     return ((int (*)(void**, size_t, size_t)) dlsym(RTLD_NEXT, "posix_memalign"))(
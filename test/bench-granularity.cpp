@@ -0,0 +1,197 @@
+/*
+ * Places a shared buffer with the weighted placement at several stripe
+ * sizes and measures the throughput of the bench-shared kernels on it:
+ * sequential reads, which the prefetchers like contiguous, and random
+ * reads, which only care about the load balance between the nodes.
+ * Run it with UNSTICKYMEM_MODE=disabled so that nothing else moves the
+ * buffer, and with BWAP_WEIGHTS to pick the weights.
+ */
+#include <sys/mman.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "unstickymem/PagePlacement.hpp"
+
+using namespace unstickymem;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void pin(int cpu) {
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(cpu, &mask);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) != 0) {
+    fprintf(stderr, "#WARN!! Couldn't pin a thread on %d\n", cpu);
+  }
+}
+
+// the bench-shared kernel: unrolled sequential loads over the slice
+static uint64_t bench_seq_read(const uint64_t *memory, size_t words,
+                               double seconds, uint64_t *fake) {
+  uint64_t bytes = 0;
+  double end = now() + seconds;
+  do {
+    for (size_t j = 0; j + 8 <= words; j += 8) {
+      *fake += memory[j] + memory[j + 1] + memory[j + 2] + memory[j + 3]
+          + memory[j + 4] + memory[j + 5] + memory[j + 6] + memory[j + 7];
+    }
+    bytes += words * sizeof(*memory);
+  } while (now() < end);
+  return bytes;
+}
+
+// independent loads of single cache lines all over the buffer
+static uint64_t bench_random_read(const uint64_t *memory, size_t words,
+                                  double seconds, uint64_t seed,
+                                  uint64_t *fake) {
+  const size_t batch = 1 << 20;
+  uint64_t bytes = 0;
+  uint64_t x = seed | 1;
+  double end = now() + seconds;
+  do {
+    for (size_t i = 0; i < batch; i++) {
+      // xorshift64
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      *fake += memory[x % words];
+    }
+    bytes += batch * 64;
+  } while (now() < end);
+  return bytes;
+}
+
+// runs the kernel on every cpu and returns the total MB/s
+static double run(const std::vector<int> &cpus, uint64_t *memory,
+                  size_t words, double seconds, bool random) {
+  std::vector<std::thread> threads;
+  std::atomic<uint64_t> total { 0 };
+  size_t slice = words / cpus.size();
+  double start = now();
+  for (size_t t = 0; t < cpus.size(); t++) {
+    threads.emplace_back([&, t] {
+      pin(cpus[t]);
+      uint64_t fake = 0;
+      uint64_t bytes = random ?
+          bench_random_read(memory, words, seconds, t + 1, &fake) :
+          bench_seq_read(memory + t * slice, slice, seconds, &fake);
+      total += bytes + (fake == 42);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  // the kernels finish their last pass past the deadline
+  return total / (now() - start) / (1 << 20);
+}
+
+static void usage(const char *app_name) {
+  fprintf(stderr, "Usage: %s [-m <MB>] [-t <seconds>] [-c <cpus>] "
+          "[-g <granularities>]\n", app_name);
+  fprintf(stderr, "\t-m: size of the shared buffer (default 1024 MB)\n");
+  fprintf(stderr, "\t-t: time each kernel runs (default 2 s)\n");
+  fprintf(stderr, "\t-c: list of cores (e.g. 0-7,9), default all\n");
+  fprintf(stderr, "\t-g: comma-separated stripe sizes (default "
+          "page,16,64K,2M)\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+  size_t megabytes = 1024;
+  double seconds = 2;
+  std::string cpu_list;
+  std::string granularities = "page,16,64K,2M";
+
+  int c;
+  while ((c = getopt(argc, argv, "hm:t:c:g:")) != -1) {
+    switch (c) {
+      case 'm':
+        megabytes = strtoul(optarg, nullptr, 10);
+        break;
+      case 't':
+        seconds = atof(optarg);
+        break;
+      case 'c':
+        cpu_list = optarg;
+        break;
+      case 'g':
+        granularities = optarg;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (megabytes == 0 || seconds <= 0) {
+    usage(argv[0]);
+  }
+
+  std::vector<int> cpus;
+  struct bitmask *mask = cpu_list.empty() ? numa_all_cpus_ptr :
+      numa_parse_cpustring_all(cpu_list.c_str());
+  if (mask == nullptr) {
+    usage(argv[0]);
+  }
+  for (unsigned int cpu = 0; cpu < mask->size; cpu++) {
+    if (numa_bitmask_isbitset(mask, cpu)) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  size_t len = megabytes << 20;
+  void *buffer = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffer == MAP_FAILED) {
+    perror("mmap");
+    return EXIT_FAILURE;
+  }
+  memset(buffer, 1, len);
+  uint64_t *memory = reinterpret_cast<uint64_t*>(buffer);
+  size_t words = len / sizeof(*memory);
+
+  printf("%zu MB on %zu cpus, %.1lf s per kernel\n", megabytes, cpus.size(),
+         seconds);
+  printf("%-12s %10s %14s %14s\n", "granularity", "place (s)", "seq (MB/s)",
+         "random (MB/s)");
+  size_t start = 0;
+  while (start <= granularities.size()) {
+    size_t comma = granularities.find(',', start);
+    if (comma == std::string::npos) {
+      comma = granularities.size();
+    }
+    std::string spec = granularities.substr(start, comma - start);
+    start = comma + 1;
+
+    size_t pages = parse_granularity(spec);
+    if (pages == 0) {
+      fprintf(stderr, "invalid granularity %s\n", spec.c_str());
+      return EXIT_FAILURE;
+    }
+    placement_granularity(pages);
+    double before = now();
+    place_pages_weighted_initial(buffer, len);
+    double placed = now() - before;
+
+    double seq = run(cpus, memory, words, seconds, false);
+    double random = run(cpus, memory, words, seconds, true);
+    printf("%-12s %10.3lf %14.2lf %14.2lf\n", spec.c_str(), placed, seq,
+           random);
+  }
+
+  munmap(buffer, len);
+  return EXIT_SUCCESS;
+}
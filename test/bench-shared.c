@@ -98,6 +98,7 @@ uint64_t bench_seq_read(uint64_t* memory_to_access, uint64_t memory_size,
     }
     
     nb_iterations++;
+    unstickymem_report_progress(memory_size);
   }
   
   return memory_size * nb_iterations;
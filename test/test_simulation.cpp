@@ -0,0 +1,314 @@
+// checks the placement and the searches against the simulated nodes, and
+// reports how fast pages get placed. run with UNSTICKYMEM_NUMA=sim
+#include <sys/mman.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "unstickymem/memory/MemoryMap.hpp"
+#include "unstickymem/numa/SimulatedNuma.hpp"
+#include "unstickymem/search/SearchStrategy.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/PlacementPlan.hpp"
+
+using namespace unstickymem;
+
+static const size_t LENGTH = 64UL << 20;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// places the pages and reads the model, without noise
+class SimulatedEvaluator : public RatioEvaluator {
+ private:
+  SimulatedNuma &_sim;
+  void *_addr;
+
+ public:
+  unsigned int evaluations = 0;
+
+  SimulatedEvaluator(SimulatedNuma &sim, void *addr)
+      : _sim(sim),
+        _addr(addr) {
+  }
+
+  StallStats evaluate(double ratio, double effort) {
+    evaluations++;
+    move_pages_remote(_addr, LENGTH, (1 - ratio) * 100);
+    StallStats stats;
+    stats.count = MIN_SAMPLER_SAMPLES;
+    stats.last = stats.ewma = stats.mean = stats.median = stats.trimmed_mean =
+        _sim.modelStallRate(_sim.pageShares());
+    return stats;
+  }
+
+  StallComparison compare(StallStats *current, const StallStats &other) {
+    return compare_stall_rates(*current, other, 0.05);
+  }
+};
+
+int main() {
+  SimulatedNuma *sim = dynamic_cast<SimulatedNuma*>(&numa());
+  if (!sim) {
+    fprintf(stderr, "needs UNSTICKYMEM_NUMA=sim\n");
+    return 1;
+  }
+  int nodes = sim->configuredNodes();
+
+  void *addr = mmap(nullptr, LENGTH, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  memset(addr, 1, LENGTH);
+
+  // the pages end up where the ratio says
+  int failures = 0;
+  size_t pages = LENGTH / numa_pagesize();
+  for (int remote = 0; remote <= 100; remote += 10) {
+    double start = now();
+    move_pages_remote(addr, LENGTH, remote);
+    double elapsed = now() - start;
+    double local = sim->pageShares()[0];
+    printf("remote %3d%%: local share %1.3lf, %1.0lf pages/s\n", remote, local,
+           pages / elapsed);
+    double tolerance = std::max(0.01, (double) placement_unit_pages() / pages);
+    if (std::fabs(local - (1 - remote / 100.0)) > tolerance) {
+      fprintf(stderr, "expected a local share of %1.2lf\n",
+              1 - remote / 100.0);
+      failures++;
+    }
+  }
+
+  // busy pages are retried right away. pages that are not faulted in yet
+  // are left to the policy of their mapping, the placement is recorded
+  // anyway and the next step has nothing to move
+  std::vector<int> expected(pages);
+  move_pages_remote(addr, LENGTH, 50);
+  for (size_t page = 0; page < pages; page++) {
+    expected[page] = sim->nodeOf(static_cast<char*>(addr)
+                                 + page * numa_pagesize());
+  }
+  MemorySegment segment(addr, static_cast<char*>(addr) + LENGTH - 1, "test");
+  for (int error : { EBUSY, ENOENT }) {
+    move_pages_remote(segment, 0);
+    sim->failMoves(100, error);
+    std::vector<size_t> misplaced;
+    for (int step = 0; step < 2; step++) {
+      move_pages_remote(segment, 50);
+      misplaced.push_back(0);
+      for (size_t page = 0; page < pages; page++) {
+        if (sim->nodeOf(static_cast<char*>(addr) + page * numa_pagesize())
+            != expected[page]) {
+          misplaced.back()++;
+        }
+      }
+    }
+    printf("%s: %zu pages misplaced, %zu after the next step\n",
+           strerror(error), misplaced[0], misplaced[1]);
+    size_t left = error == EBUSY ? 0 : 100;
+    if (misplaced[0] != left || misplaced[1] != left
+        || !segment.placement().known()) {
+      fprintf(stderr, "expected %zu pages left behind and the placement "
+              "recorded\n", left);
+      failures++;
+    }
+  }
+
+  // a segment replaced while its pages moved does not keep the placement
+  // they were moved to
+  MemoryMap &segments = MemoryMap::getInstance();
+  const size_t block_length = 8UL << 20;
+  char *block = static_cast<char*>(mmap(nullptr, block_length,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  memset(block, 1, block_length);
+  MemorySegment copy(block, block, "");
+  segments.copySegment(block, &copy);
+  move_pages_remote(copy, 50);
+  bool stored = segments.updateSegment(copy);
+  mmap(block, block_length / 2, PROT_READ | PROT_WRITE,
+       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+  memset(block, 1, block_length / 2);
+  MemorySegment current(block, block, "");
+  segments.copySegment(block, &current);
+  move_pages_remote(current, 50);
+  stored &= segments.updateSegment(current);
+  move_pages_remote(copy, 0);
+  bool replaced = !segments.updateSegment(copy);
+  bool forgotten = segments.copySegment(block, &current)
+      && !current.placement().known();
+  printf("replaced segment: stored %d, rejected %d, placement forgotten %d\n",
+         stored, replaced, forgotten);
+  if (!stored || !replaced || !forgotten) {
+    fprintf(stderr, "the placement of a replaced segment is kept\n");
+    failures++;
+  }
+  munmap(block, block_length);
+
+  // the weighted plans give every node its share to within a unit, and
+  // walking their pages agrees with looking them up
+  std::mt19937 random(1);
+  for (int trial = 0; trial < 1000; trial++) {
+    size_t unit_pages = 1 + random() % 4;
+    UnitLayout layout = unit_layout(
+        reinterpret_cast<void*>((random() % 64) * numa_pagesize()),
+        1 + random() % 5000, unit_pages);
+    std::vector<double> weights(nodes);
+    for (double &weight : weights) {
+      weight = random() % 100;
+    }
+    weights[random() % nodes] += 1;
+    double total = 0;
+    for (double weight : weights) {
+      total += weight;
+    }
+    // the spread plan is exact over each period of its pattern
+    double spread_slack = 1 + layout.units / SPREAD_PERIOD;
+    for (const auto &checked : {
+        std::make_pair(PlacementPlan::interleaved(layout, weights), 1.0),
+        std::make_pair(PlacementPlan::contiguous(layout, weights), 1.0),
+        std::make_pair(PlacementPlan::spread(layout, weights),
+                       spread_slack) }) {
+      const PlacementPlan &plan = checked.first;
+      std::vector<size_t> counts(nodes, 0);
+      for (size_t unit = 0; unit < layout.units; unit++) {
+        counts[plan.nodeOf(unit)]++;
+      }
+      std::vector<size_t> planned = plan.nodeUnits();
+      planned.resize(nodes, 0);
+      for (int node = 0; node < nodes; node++) {
+        double share = weights[node] / total * layout.units;
+        if (counts[node] != planned[node]
+            || std::fabs(counts[node] - share) >= checked.second) {
+          fprintf(stderr, "node %d gets %zu of %zu units for a weight of "
+                  "%1.0lf/%1.0lf\n", node, counts[node], layout.units,
+                  weights[node], total);
+          failures++;
+          trial = 1000;
+        }
+      }
+      size_t from = random() % layout.pages;
+      for (PlanCursor cursor(plan, from); !cursor.done(); cursor.next()) {
+        if (cursor.node() != plan.nodeOfPage(from++)) {
+          fprintf(stderr, "the cursor disagrees on page %zu\n", from - 1);
+          failures++;
+          trial = 1000;
+          break;
+        }
+      }
+    }
+  }
+
+  // plans of a terabyte of pages are as small and as quick to build
+  size_t terabyte = (1UL << 40) / numa_pagesize();
+  for (int remote = 0; remote <= 100; remote += 25) {
+    double start = now();
+    PlacementPlan plan = PlacementPlan::remoteRatio(
+        unit_layout(nullptr, terabyte, 1), remote, { 0 }, { 1, 2, 3 });
+    double elapsed = now() - start;
+    printf("1 TB at %3d%% remote: %zu stripes in %1.6lfs\n", remote,
+           plan.stripes().size(), elapsed);
+    size_t window = terabyte / 2;
+    for (PlanCursor cursor(plan, window); window < terabyte / 2 + 100000;
+        cursor.next()) {
+      if (cursor.node() != plan.nodeOfPage(window++)) {
+        fprintf(stderr, "the cursor disagrees on page %zu\n", window - 1);
+        failures++;
+        break;
+      }
+    }
+    if (plan.stripes().size() > 2) {
+      failures++;
+    }
+  }
+
+  // and so do the placers that use them, to within a page or a stripe
+  std::vector<double> weights = node_weights();
+  double total = 0;
+  for (double weight : weights) {
+    total += weight;
+  }
+  move_pages_initial(addr, LENGTH);
+  std::vector<double> shares = sim->pageShares();
+  place_pages_weighted_initial(addr, LENGTH);
+  std::vector<double> bound = sim->pageShares();
+  for (int node = 0; node < nodes; node++) {
+    double target = weights[node] / total;
+    printf("node %d: weight %1.3lf, moved %1.3lf, bound %1.3lf\n", node,
+           target, shares[node], bound[node]);
+    double unit = placement_unit_pages();
+    if (std::fabs(shares[node] - target) * pages >= unit
+        || std::fabs(bound[node] - target) * pages >= unit) {
+      fprintf(stderr, "the weighted placement misses its weights\n");
+      failures++;
+    }
+  }
+
+  // new weights reach the segments placed after them
+  if (nodes > 1 && weights[nodes - 1] > 0) {
+    if (!numa_bitmask_isbitset(weighted_nodes_nodemask(), nodes - 1)) {
+      failures++;
+    }
+    std::vector<double> tuned = weights;
+    tuned[nodes - 1] = 0;
+    set_node_weights(tuned);
+    place_pages_weighted_initial(addr, LENGTH);
+    if (numa_bitmask_isbitset(weighted_nodes_nodemask(), nodes - 1)
+        || sim->pageShares()[nodes - 1] > 0) {
+      fprintf(stderr, "the placement ignores the new weights\n");
+      failures++;
+    }
+    set_node_weights(weights);
+    move_pages_initial(addr, LENGTH);
+  }
+
+  // the model's own optimum, on the grid the searches use
+  SearchSpace space = { 0.25, 1.0, 0.05, 10 };
+  if (nodes < 4) {
+    space.low = 1.0 / nodes;
+  }
+  double best_ratio = space.low;
+  double best_rate = INFINITY;
+  SimulatedEvaluator scan(*sim, addr);
+  for (double ratio = space.low; ratio <= space.high + 1e-9;
+      ratio += space.resolution) {
+    double rate = scan.evaluate(ratio, 1.0).mean;
+    if (rate < best_rate) {
+      best_rate = rate;
+      best_ratio = ratio;
+    }
+  }
+  printf("model optimum: %1.2lf (stall rate %1.4lf)\n", best_ratio, best_rate);
+
+  // every search gets close to it
+  for (const char *name : { "linear", "golden", "halving", "bayesian" }) {
+    SimulatedEvaluator evaluator(*sim, addr);
+    double start = now();
+    double ratio = SearchStrategy::getStrategy(name)->search(evaluator, space);
+    double elapsed = now() - start;
+    unsigned int evaluations = evaluator.evaluations;
+    double rate = evaluator.evaluate(ratio, 1.0).mean;
+    printf("%-10s %1.2lf after %2u evaluations in %1.3lfs (stall rate "
+           "%1.4lf)\n", name, ratio, evaluations, elapsed, rate);
+    if (std::fabs(ratio - best_ratio) > 0.1 + 1e-9) {
+      fprintf(stderr, "%s is too far from the optimum\n", name);
+      failures++;
+    }
+  }
+
+  munmap(addr, LENGTH);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}